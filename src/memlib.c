@@ -1,54 +1,583 @@
+#define _GNU_SOURCE  // MAP_ANONYMOUS, MAP_NORESERVE, MAP_POPULATE, MADV_HUGEPAGE, memfd_create
+
 #include "memlib.h"
 
-#include <stdio.h>   // fprintf
-#include <stdlib.h>  // malloc, free, exit
-#include <errno.h>   // ENOMEM
+#include <stdio.h>     // fprintf
+#include <stdlib.h>    // malloc, free, exit
+#include <errno.h>     // ENOMEM
+#include <stdint.h>    // uintptr_t
+#include <unistd.h>    // sysconf, ftruncate, close
+#include <fcntl.h>     // open
+#include <sys/stat.h>  // fstat
+#include <sys/mman.h>  // mmap, mremap, munmap, mprotect, madvise, shm_open
+
+#define MAX_HEAP (40*(1<<20))     /* 40 MB */
+#define COMMIT_CHUNK (64*(1<<10)) /* 64 KB */
+#define HUGE_PAGE (2*(1<<20))     /* 2 MB */
+#define MAX_REGIONS 1024
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000  // Linux 4.17 (older kernels take it as a hint)
+#endif
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+
+typedef struct {
+    char *start;
+    long size;
+} MemRegion;
+
+/*
+ * The state of a heap. Besides the default heap, `mem_create` makes heaps with
+ * their own reserved range, regions and files; `mem_select` chooses the heap
+ * that all other functions act on.
+ */
+struct MemHeap {
+    MemConfig config;
+    char *start_brk;
+    char *brk;
+    char *max_addr;
+
+    /*
+     * Second break, moving down from the end of the range (see `mem_sbrk_top`):
+     * [top_brk, top_end()) is in use at the top. The two breaks never cross.
+     */
+    char *top_brk;
+    char *commit_top;    // first committed page of the top part (anonymous memory)
+
+    /*
+     * With MEM_BACKING_ANON, the whole heap limit is reserved as an inaccessible
+     * range (PROT_NONE, no swap reserved) and pages are committed (made readable
+     * and writable) in chunks, only when mem_sbrk moves the break past them.
+     */
+    char *map;           // start of the mapping (before alignment)
+    long map_size;       // size of the mapping
+    char *commit_brk;    // end of the committed pages
+    long commit_chunk;   // commit granularity
+
+    /*
+     * With MEM_BACKING_MEMFD, committed pages are shared mappings of a memory
+     * file instead of anonymous memory. `mem_remap` can then move pages between
+     * two heap ranges by mapping their file pages at the other address:
+     * `file_page` gives the file page mapped at each heap page (initially the
+     * same index).
+     *
+     * With MEM_BACKING_FILE (or MEM_BACKING_SHM), the heap is a shared mapping
+     * of a regular file (or POSIX shared-memory object), page for page, and is
+     * never truncated: its contents survive `mem_deinit`, and other processes
+     * mapping the same file see the same heap.
+     */
+    int fd;
+    int *file_page;
+    long file_size;      // current size of the memfd or heap file
+
+    /*
+     * Extra regions, handed out by `mem_region` once the contiguous heap is
+     * full. They are mapped at once (no reserve/commit) and released on reset.
+     */
+    MemRegion regions[MAX_REGIONS];
+    int regions_len;
+    long regions_size;   // total size of the extra regions
+};
+
+static MemHeap mem_default = {.config = {MEM_BACKING_ANON, MAX_HEAP, 0, 0, NULL}, .fd = -1};
+static MemHeap *mem = &mem_default;  // selected heap
+
+static long mem_page_size;
+
+static char *align_up(char *addr, long alignment) {
+    return (char *)(((uintptr_t)addr + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+/**
+ * End of the top part of the range (see `mem_sbrk_top`), 8-byte aligned.
+ */
+static char *top_end(void) {
+    return mem->start_brk + (mem->config.limit & ~7L);
+}
+
+/**
+ * With `prefault`, commit the whole range of an anonymous heap and populate
+ * its pages at once, before the heap is used: neither `mem_sbrk` nor the
+ * accesses to the heap fault afterwards. Other backings populate pages as
+ * they are committed.
+ */
+static void mem_populate(void) {
+    if (!mem->config.prefault || mem->config.backing != MEM_BACKING_ANON)
+        return;
+    long size = (long)align_up((char *)mem->config.limit, mem->commit_chunk);
+    if (mmap(mem->start_brk, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED | MAP_POPULATE, -1, 0) != MAP_FAILED)
+        mem->commit_brk = mem->start_brk + size;
+}
+
+/**
+ * Set the heap configuration used by the next `mem_init`.
+ *
+ * @param config backing, limit and page options (a limit of 0 means 40 MB)
+ */
+void mem_configure(const MemConfig *config) {
+    mem->config = *config;
+    if (mem->config.limit <= 0)
+        mem->config.limit = MAX_HEAP;
+}
+
+/**
+ * Make the state of a new heap, with its own configuration. Select it (see
+ * `mem_select`) before calling `mem_init` and the other functions on it.
+ *
+ * @param config backing, limit and page options (a limit of 0 means 40 MB)
+ * @return the new heap, or `NULL` if out of memory
+ */
+MemHeap *mem_create(const MemConfig *config) {
+    MemHeap *heap = calloc(1, sizeof(MemHeap));
+    if (heap == NULL)
+        return NULL;
+    heap->fd = -1;
+    heap->config = *config;
+    if (heap->config.limit <= 0)
+        heap->config.limit = MAX_HEAP;
+    return heap;
+}
 
-#define MAX_HEAP (40*(1<<20))  /* 40 MB */
+/**
+ * Choose the heap that the other functions act on.
+ *
+ * @param heap a heap from `mem_create`, or `NULL` for the default heap
+ * @return the heap selected before
+ */
+MemHeap *mem_select(MemHeap *heap) {
+    MemHeap *previous = mem;
+    mem = (heap != NULL) ? heap : &mem_default;
+    return previous;
+}
 
-static char *mem_start_brk;
-static char *mem_brk;
-static char *mem_max_addr;
+/**
+ * Release a heap from `mem_create` (after `mem_deinit`, which does nothing on
+ * a heap never initialized) and its state. The default heap is selected if it
+ * was the selected one.
+ *
+ * @param heap a heap from `mem_create`
+ */
+void mem_destroy(MemHeap *heap) {
+    MemHeap *previous = mem_select(heap);
+    mem_deinit();
+    mem_select(previous == heap ? NULL : previous);
+    free(heap);
+}
 
 void mem_init(void) {
-    mem_start_brk = malloc(MAX_HEAP);
-    if (mem_start_brk == NULL) {
-        fprintf(stderr, "Cannot allocate heap region\n");
-        exit(1);
+    long limit = mem->config.limit;
+
+    if (mem->config.backing == MEM_BACKING_MALLOC) {
+        mem->map = NULL;
+        mem->start_brk = malloc(limit);
+        if (mem->start_brk == NULL) {
+            fprintf(stderr, "Cannot allocate heap region\n");
+            exit(1);
+        }
+        mem->commit_brk = mem->start_brk + limit;
+
+    } else {
+        long alignment = mem->config.huge_pages ? HUGE_PAGE : sysconf(_SC_PAGESIZE);
+        mem->commit_chunk = mem->config.huge_pages ? HUGE_PAGE : COMMIT_CHUNK;
+        mem->map_size = (long)align_up((char *)limit, mem->commit_chunk) + alignment;
+        mem->map = mmap(NULL, mem->map_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem->map == MAP_FAILED) {
+            fprintf(stderr, "Cannot reserve heap region\n");
+            exit(1);
+        }
+        mem->start_brk = align_up(mem->map, alignment);
+        mem->commit_brk = mem->start_brk;
+        if (mem->config.huge_pages)
+            madvise(mem->start_brk, mem->map_size - alignment, MADV_HUGEPAGE);
+    }
+
+    mem_page_size = sysconf(_SC_PAGESIZE);
+    if (mem->config.backing == MEM_BACKING_MEMFD) {
+        long pages = (mem->map_size - mem_page_size) / mem_page_size;
+        mem->fd = memfd_create("memlib", 0);
+        mem->file_size = 0;
+        mem->file_page = malloc(pages * sizeof(int));
+        if (mem->fd < 0 || mem->file_page == NULL) {
+            fprintf(stderr, "Cannot create heap file\n");
+            exit(1);
+        }
+        for (long i = 0; i < pages; i++)
+            mem->file_page[i] = i;
+    } else if (mem->config.backing == MEM_BACKING_FILE || mem->config.backing == MEM_BACKING_SHM) {
+        struct stat st;
+        if (mem->config.backing == MEM_BACKING_SHM)
+            mem->fd = shm_open(mem->config.path, O_RDWR | O_CREAT, 0600);
+        else
+            mem->fd = open(mem->config.path, O_RDWR | O_CREAT, 0600);
+        if (mem->fd < 0 || fstat(mem->fd, &st) < 0) {
+            fprintf(stderr, "Cannot open heap file %s\n", mem->config.path);
+            exit(1);
+        }
+        mem->file_size = st.st_size;
     }
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;
-    mem_brk = mem_start_brk;
+    mem->max_addr = mem->start_brk + limit;
+    mem->brk = mem->start_brk;
+    mem->top_brk = top_end();
+    mem->commit_top = mem->top_brk;
+    mem_populate();
+}
+
+/**
+ * Give all extra regions back to the OS.
+ */
+static void mem_release_regions(void) {
+    for (int i = 0; i < mem->regions_len; i++) {
+        if (mem->map == NULL)
+            free(mem->regions[i].start);
+        else
+            munmap(mem->regions[i].start, mem->regions[i].size);
+    }
+    mem->regions_len = 0;
+    mem->regions_size = 0;
 }
 
 void mem_deinit(void) {
-    free(mem_start_brk);
+    mem_release_regions();
+    if (mem->fd >= 0) {
+        if (mem->config.backing == MEM_BACKING_FILE)
+            msync(mem->start_brk, mem->commit_brk - mem->start_brk, MS_SYNC);
+        close(mem->fd);
+        free(mem->file_page);
+        mem->file_page = NULL;
+        mem->fd = -1;
+    }
+    if (mem->map == NULL)
+        free(mem->start_brk);
+    else
+        munmap(mem->map, mem->map_size);
 }
 
 void mem_reset_brk() {
-    mem_brk = mem_start_brk;
+    mem->brk = mem->start_brk;
+    mem->top_brk = top_end();
+    mem_release_regions();
+}
+
+/**
+ * Reset the break and give all committed pages back to the OS, so that they
+ * are committed (and faulted in) again as the heap grows; with `prefault`,
+ * fresh pages are populated right away.
+ */
+void mem_decommit(void) {
+    mem->brk = mem->start_brk;
+    mem->top_brk = top_end();
+    mem_release_regions();
+    if (mem->map == NULL)
+        return;
+    if (mem->commit_top < mem->top_brk) {
+        mmap(mem->commit_top, mem->top_brk - mem->commit_top, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        mem->commit_top = mem->top_brk;
+    }
+    if (mem->commit_brk > mem->start_brk) {
+        // a new PROT_NONE mapping over the committed range drops its pages
+        long size = mem->commit_brk - mem->start_brk;
+        mmap(mem->start_brk, size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+        if (mem->config.huge_pages)
+            madvise(mem->start_brk, size, MADV_HUGEPAGE);
+        if (mem->file_page != NULL) {
+            ftruncate(mem->fd, 0);
+            mem->file_size = 0;
+            for (long i = 0; i < size / mem_page_size; i++)
+                mem->file_page[i] = i;
+        }
+        mem->commit_brk = mem->start_brk;
+    }
+    mem_populate();
+}
+
+/**
+ * Commit pages of the reserved range up to (at least) `end`.
+ *
+ * @param end first byte that does not need to be committed
+ * @return 0 on success, -1 on error
+ */
+static int mem_commit(char *end) {
+    // chunks are counted from the heap start, which is only page-aligned
+    char *new_commit_brk = mem->start_brk + (long)align_up((char *)(end - mem->start_brk), mem->commit_chunk);
+    long size = new_commit_brk - mem->commit_brk;
+    if (mem->fd >= 0) {
+        // file pages are mapped at the same offset as their heap pages
+        long offset = mem->commit_brk - mem->start_brk;
+        struct stat st;
+        if (offset + size > mem->file_size && mem->file_page == NULL && fstat(mem->fd, &st) == 0)
+            mem->file_size = st.st_size;  // another process may have grown the file
+        if (offset + size > mem->file_size) {
+            if (ftruncate(mem->fd, offset + size) < 0)
+                return -1;
+            mem->file_size = offset + size;
+        }
+        if (mmap(mem->commit_brk, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                mem->fd, offset) == MAP_FAILED)
+            return -1;
+    } else if (mprotect(mem->commit_brk, size, PROT_READ | PROT_WRITE) < 0) {
+        return -1;
+    }
+
+    if (mem->config.prefault) {
+        // touch ahead, so that the heap does not fault while it is used
+        long page_size = sysconf(_SC_PAGESIZE);
+        for (volatile char *p = mem->commit_brk; p < new_commit_brk; p += page_size)
+            *p = 0;
+    }
+
+    mem->commit_brk = new_commit_brk;
+    return 0;
 }
 
 char *mem_sbrk(int incr) {
-    char *old_brk = mem_brk;
-    if (incr < 0 || (mem_brk + incr) > mem_max_addr) {
+    char *old_brk = mem->brk;
+    if (incr < 0 || (mem->brk + incr) > mem->top_brk ||
+        ((mem->brk + incr) > mem->commit_brk && mem_commit(mem->brk + incr) < 0)) {
         errno = ENOMEM;
         fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
         return (void *)-1;
     }
 
-    mem_brk += incr;
+    mem->brk += incr;
     return old_brk;
 }
 
+/**
+ * Move the break back, giving the whole pages past it back to the OS (their
+ * contents are lost, they stay committed), unless they were prefaulted.
+ *
+ * @param decr number of bytes to remove from the end of the heap
+ * @return 0 on success, -1 if the heap is smaller than `decr`
+ */
+int mem_trim(int decr) {
+    if (decr < 0 || decr > mem->brk - mem->start_brk)
+        return -1;
+    mem->brk -= decr;
+
+    // a shared file or object keeps its pages: other mappings may use them
+    if (mem->map != NULL && !mem->config.prefault && (mem->fd < 0 || mem->file_page != NULL)) {
+        char *first_page = align_up(mem->brk, mem_page_size);
+        char *end = MIN(mem->commit_brk, mem->top_brk - (uintptr_t)mem->top_brk % mem_page_size);
+        if (first_page < end)
+            madvise(first_page, end - first_page, MADV_DONTNEED);
+    }
+    return 0;
+}
+
+/**
+ * Move the top break down, so that `incr` more bytes are in use at the top of
+ * the range (for allocators that grow from both ends). Only for anonymous or
+ * malloc-backed heaps.
+ *
+ * @param incr number of bytes to add below the top part (a multiple of 8)
+ * @return the new top break (first byte of the added bytes), or (void *)-1
+ *         if the breaks would cross or the heap is file-backed
+ */
+char *mem_sbrk_top(int incr) {
+    if (incr < 0 || mem->fd >= 0 || incr > mem->top_brk - mem->brk) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+    char *new_top = mem->top_brk - incr;
+    if (mem->map != NULL && new_top < mem->commit_top) {
+        char *first_page = new_top - (uintptr_t)new_top % mem_page_size;
+        if (mprotect(first_page, mem->commit_top - first_page, PROT_READ | PROT_WRITE) < 0) {
+            errno = ENOMEM;
+            return (void *)-1;
+        }
+        if (mem->config.prefault) {
+            for (volatile char *p = first_page; p < mem->commit_top; p += mem_page_size)
+                *p = 0;
+        }
+        mem->commit_top = first_page;
+    }
+    mem->top_brk = new_top;
+    return new_top;
+}
+
+/**
+ * Move the top break back up, giving the whole pages below it back to the OS
+ * (their contents are lost, they stay committed), unless they were
+ * prefaulted.
+ *
+ * @param decr number of bytes to remove from the bottom of the top part
+ * @return 0 on success, -1 if the top part is smaller than `decr`
+ */
+int mem_trim_top(int decr) {
+    if (decr < 0 || decr > top_end() - mem->top_brk)
+        return -1;
+    char *old_top = mem->top_brk;
+    mem->top_brk += decr;
+
+    if (mem->map != NULL && !mem->config.prefault) {
+        char *first_page = align_up(MAX(old_top, mem->brk), mem_page_size);
+        char *end = mem->top_brk - (uintptr_t)mem->top_brk % mem_page_size;
+        if (first_page < end)
+            madvise(first_page, end - first_page, MADV_DONTNEED);
+    }
+    return 0;
+}
+
+/**
+ * Bytes that `mem_sbrk` can still add to the contiguous heap.
+ *
+ * @return number of bytes before the heap limit (or the top break)
+ */
+long mem_brk_avail(void) {
+    return mem->top_brk - mem->brk;
+}
+
+/**
+ * Map a new region of memory, not contiguous with the heap or other regions,
+ * for allocators that can manage several regions once `mem_sbrk` fails.
+ * Regions are mapped just below the reserved range (or the previous region)
+ * when that range is free, so that they stay close to the heap: allocators
+ * may then reach them with 32-bit offsets from the heap (see `add_region` in
+ * `mm.c`), which they must check.
+ *
+ * @param size size of the region in bytes
+ * @return address of the region (page-aligned), or (void *)-1 on error
+ */
+char *mem_region(long size) {
+    // regions are private, anonymous memory: not in the heap file or object
+    if (size <= 0 || mem->regions_len == MAX_REGIONS ||
+        mem->config.backing == MEM_BACKING_FILE || mem->config.backing == MEM_BACKING_SHM) {
+        errno = ENOMEM;
+        return (void *)-1;
+    }
+
+    char *start;
+    if (mem->map == NULL) {
+        start = malloc(size);
+        if (start == NULL)
+            return (void *)-1;
+    } else {
+        size = (long)align_up((char *)size, sysconf(_SC_PAGESIZE));
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | (mem->config.prefault ? MAP_POPULATE : 0);
+        char *below = (mem->regions_len > 0) ? mem->regions[mem->regions_len - 1].start : mem->map;
+        start = MAP_FAILED;
+        if ((uintptr_t)below > (uintptr_t)size)
+            start = mmap(below - size, size, PROT_READ | PROT_WRITE, flags | MAP_FIXED_NOREPLACE, -1, 0);
+        if (start == MAP_FAILED)
+            start = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (start == MAP_FAILED)
+            return (void *)-1;
+        if (mem->config.huge_pages)
+            madvise(start, size, MADV_HUGEPAGE);
+    }
+
+    mem->regions[mem->regions_len].start = start;
+    mem->regions[mem->regions_len].size = size;
+    mem->regions_len++;
+    mem->regions_size += size;
+    return start;
+}
+
+/**
+ * Check whether `mem_remap` can move pages (the heap is backed by a memfd).
+ *
+ * @return 1 if pages can be remapped, 0 otherwise
+ */
+int mem_can_remap(void) {
+    return mem->file_page != NULL;
+}
+
+/**
+ * Map the file pages listed in `mem->file_page` for `pages` heap pages, with
+ * one `mmap` per run of consecutive file pages.
+ *
+ * @param first index of the first heap page
+ * @param pages number of heap pages
+ * @return 0 on success, -1 on error
+ */
+static int mem_map_pages(long first, long pages) {
+    long run = first;
+    for (long i = first + 1; i <= first + pages; i++) {
+        if (i < first + pages && mem->file_page[i] == mem->file_page[i - 1] + 1)
+            continue;
+        if (mmap(mem->start_brk + run * mem_page_size, (i - run) * mem_page_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                mem->fd, (long)mem->file_page[run] * mem_page_size) == MAP_FAILED)
+            return -1;
+        run = i;
+    }
+    return 0;
+}
+
+/**
+ * Exchange the pages of two page-aligned, disjoint heap ranges without
+ * copying: afterwards, `dst` holds the bytes of `src` (and `src` holds the old
+ * bytes of `dst`). The cost depends on the number of runs of pages, not on
+ * their size.
+ *
+ * @param dst page-aligned destination range
+ * @param src page-aligned source range
+ * @param len length of both ranges (a multiple of the page size)
+ * @return 0 on success, -1 if the heap is not backed by a memfd or the ranges
+ *         are not page-aligned committed heap pages
+ */
+int mem_remap(char *dst, char *src, long len) {
+    if (mem->file_page == NULL || len <= 0 || (uintptr_t)dst % mem_page_size != 0 ||
+        (uintptr_t)src % mem_page_size != 0 || len % mem_page_size != 0)
+        return -1;
+    if (dst < mem->start_brk || dst + len > mem->commit_brk ||
+        src < mem->start_brk || src + len > mem->commit_brk ||
+        (dst < src + len && src < dst + len))
+        return -1;
+
+    long d = (dst - mem->start_brk) / mem_page_size;
+    long s = (src - mem->start_brk) / mem_page_size;
+    long pages = len / mem_page_size;
+    int single_run = mem->file_page[s + pages - 1] == mem->file_page[s] + pages - 1;
+    for (long i = 0; i < pages; i++) {
+        int file_page = mem->file_page[d + i];
+        mem->file_page[d + i] = mem->file_page[s + i];
+        mem->file_page[s + i] = file_page;
+    }
+
+    // one run of file pages is one mapping: move its page tables instead of
+    // tearing them down, then map the pages of dst (rarely populated) at src
+    if (single_run && mremap(src, len, len, MREMAP_MAYMOVE | MREMAP_FIXED, dst) != MAP_FAILED)
+        return mem_map_pages(s, pages);
+    return (mem_map_pages(d, pages) < 0 || mem_map_pages(s, pages) < 0) ? -1 : 0;
+}
+
+/**
+ * Check whether a range of bytes lies inside the heap or one of its regions.
+ *
+ * @param lo first byte of the range
+ * @param hi last byte of the range
+ * @return 1 if the whole range is heap memory, 0 otherwise
+ */
+int mem_contains(const char *lo, const char *hi) {
+    if (lo >= mem->start_brk && hi < mem->brk)
+        return 1;
+    if (lo >= mem->top_brk && hi < top_end())
+        return 1;
+    for (int i = 0; i < mem->regions_len; i++) {
+        char *start = mem->regions[i].start;
+        if (lo >= start && hi < start + mem->regions[i].size)
+            return 1;
+    }
+    return 0;
+}
+
 char *mem_heap_lo() {
-    return mem_start_brk;  // first heap byte
+    return mem->start_brk;  // first heap byte
 }
 
 char *mem_heap_hi() {
-    return mem_brk - 1;  // last heap byte
+    return mem->brk - 1;  // last heap byte
 }
 
 long mem_heapsize() {
-    return mem_brk - mem_start_brk;
+    long top = top_end() - mem->top_brk;
+    return (mem->brk - mem->start_brk) + top + mem->regions_size;
 }
@@ -1,10 +1,50 @@
 #ifndef __MEMLIB_H__
 #define __MEMLIB_H__
 
+/**
+ * Where the heap memory comes from.
+ */
+typedef enum {
+    MEM_BACKING_ANON,    // virtual range reserved with mmap, committed by mem_sbrk
+    MEM_BACKING_MALLOC,  // the whole heap limit taken from malloc at once
+    MEM_BACKING_MEMFD,   // like ANON, but pages are shared mappings of a memfd
+    MEM_BACKING_FILE,    // shared mapping of a regular file, kept after mem_deinit
+    MEM_BACKING_SHM,     // shared mapping of a POSIX shared-memory object
+} MemBacking;
+
+/**
+ * Heap configuration, applied by the next `mem_init`.
+ */
+typedef struct {
+    MemBacking backing;
+    long limit;          // maximum heap size in bytes (0 for the default, 40 MB)
+    int  prefault;       // populate pages up front (whole range if anonymous), keep them on trims
+    int  huge_pages;     // 2 MB-aligned range backed by transparent huge pages
+    const char *path;    // heap file (MEM_BACKING_FILE) or object name (MEM_BACKING_SHM)
+} MemConfig;
+
+/**
+ * State of a heap (see `mem_create`).
+ */
+typedef struct MemHeap MemHeap;
+
+void  mem_configure(const MemConfig *config);
+MemHeap *mem_create(const MemConfig *config);
+MemHeap *mem_select(MemHeap *heap);
+void  mem_destroy(MemHeap *heap);
 void  mem_init(void);
 void  mem_deinit(void);
 char *mem_sbrk(int incr);
+char *mem_sbrk_top(int incr);
+int   mem_trim(int decr);
+int   mem_trim_top(int decr);
 void  mem_reset_brk(void);
+void  mem_decommit(void);
+long  mem_brk_avail(void);
+char *mem_region(long size);
+int   mem_can_remap(void);
+int   mem_remap(char *dst, char *src, long len);
+int   mem_contains(const char *lo, const char *hi);
 char *mem_heap_lo(void);
 char *mem_heap_hi(void);
 long  mem_heapsize(void);
@@ -1,12 +1,391 @@
+#define _POSIX_C_SOURCE 200809L  // robust mutexes
+
 #include "mm.h"        // prototypes of functions implemented in this file
 #include "mm_list.h"   // "mm_list_..."  functions -- to manage explicit free list
 #include "mm_block.h"  // "mm_block_..." functions -- to manage blocks on the heap
+#include "mm_index.h"  // "mm_index_..." functions -- packed index of free sizes
+#include "mm_cache.h"  // "mm_cache_..." functions -- free blocks by exact size
+#include "mm_tiny.h"   // "mm_tiny_..."  functions -- cells for requests of up to 8 bytes
+#include "mm_bitmap.h" // "mm_bitmap_..." functions -- block tags out of band
+#include "mm_span.h"   // "mm_span_..."  functions -- page heap for large requests
 #include "memlib.h"    // mem_sbrk -- to extend the heap
+#include <stdlib.h>    // malloc, free -- state of extra heaps
 #include <string.h>    // memcpy -- to copy regions of memory
+#include <stdint.h>    // uintptr_t
+#include <limits.h>    // INT_MAX -- reach of the free-list links
+#include <unistd.h>    // sysconf -- page size for remapping
+#include <errno.h>     // EOWNERDEAD
+#include <pthread.h>   // pthread_mutex_... -- to lock a shared heap
+#include <sched.h>     // sched_yield
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define MIN(x, y) ((x) > (y) ? (y) : (x))
 
+#define REGION_SIZE (1 << 20)  /* minimum size of an extra heap region */
+#define REGION_OVERHEAD 16     /* alignment word, prologue and epilogue */
+#define REMAP_THRESHOLD (256 * (1 << 10))  /* smallest payload moved by remapping */
+#define MM_MAGIC 0x6d6d6831                  /* "mmh1", marks a heap file */
+#define MM_MAGIC_BUSY 0x6d6d6830             /* "mmh0", heap being created */
+#define MAX_HANDLES (1 << 16)
+#define RELOCATE_FREE_RATIO 4                /* realloc relocates when over 1/4 of the heap is free */
+#define RELOCATE_CANDIDATES 8                /* free blocks examined by realloc_relocate */
+#define COMPACT_SKIP_COST 16                 /* work charged for stepping over a block */
+#define TRIM_THRESHOLD 4096                  /* smallest top chunk given back by mm_compact */
+#define STACK_RUN 4                          /* frees in stack order in a row that start the stack path */
+#define STACK_RECENT 16                      /* recent allocations checked for stack order */
+#define MAX_SITE_HEAPS 8
+#define SITE_SLOTS 1024                      /* call sites tracked (hashed, may share a slot) */
+#define SITE_ADAPT 64                        /* allocations of a site between two heap choices */
+#define SITE_CLASS_BITS 6                    /* each site heap gets 64x longer lifetimes */
+#define SITE_TICK_BITS 20                    /* bits of the allocation clock kept in a block */
+
+/**
+ * Metadata of a heap file, stored at its start (see `mm_attach`). Addresses
+ * are offsets, so that the file can be mapped anywhere: `blocks` from the
+ * superblock, the others from `heap_blocks` (0 for NULL).
+ */
+typedef struct {
+    int magic;
+    int heap_size;        // bytes of the heap in use, superblock included
+    int blocks;           // offset of `heap_blocks`
+    int free_head;        // first block of the free list
+    int free_tail;        // last block of the free list
+    int root;             // payload registered with `mm_set_root`
+    int allocated_bytes;
+    int unused;           // keeps the heap 8-byte aligned
+    pthread_mutex_t lock; // process-shared, held during operations on a shared heap
+} Superblock;
+
+/**
+ * Superblock of an attached heap file, `NULL` for a heap built by `mm_init`.
+ */
+static Superblock *superblock;
+
+/**
+ * Set when the attached heap is shared with other processes: operations then
+ * take the lock and start from the state in the superblock.
+ */
+static int shared;
+
+/**
+ * Placement policy of `find_fit`.
+ */
+static MmFitPolicy fit_policy = MM_FIRST_FIT;
+
+/**
+ * Policy selected by `mm_set_fit_policy`, restored by `mm_init` (a shared heap
+ * overrides `fit_policy` while it is attached).
+ */
+static MmFitPolicy fit_policy_next = MM_FIRST_FIT;
+
+/**
+ * Set when the free blocks of the heap are also kept in the exact-size cache
+ * (`mm_cache_...`): for the default heap built by `mm_init` after
+ * `mm_set_size_cache(1)`, not for attached heaps (whose free list other
+ * processes may change) or created heaps.
+ */
+static int size_cache_on;
+static int size_cache_next;  // `size_cache_on` from the next `mm_init`
+
+/**
+ * Set when the allocated bits of blocks are also kept in the side bitmap
+ * (`mm_bitmap_...`), and allocated blocks have no footer: for the default
+ * heap built by `mm_init` after `mm_set_bitmap(1)`.
+ */
+static int bitmap_on;
+static int bitmap_next;  // `bitmap_on` from the next `mm_init`
+
+/**
+ * Bytes in allocated blocks (including headers and footers).
+ */
+static long allocated_bytes;
+
+/**
+ * Handles (see `mm_halloc`): offset of the block owned by each handle, and the
+ * stack of handles released by `mm_hfree`. Handle 0 is never used.
+ */
+static int handle_blocks[MAX_HANDLES];
+static MmHandle handle_free[MAX_HANDLES];
+static int handle_free_len;
+static int handle_next;  // lowest handle never used
+
+/**
+ * Block where the next `mm_compact` resumes (`NULL` to start from the first
+ * block); kept on a block header when blocks are merged.
+ */
+static BlockHeader *compact_cursor;
+
+/**
+ * Stack fast path, for code that allocates and frees in stack order. After
+ * `STACK_RUN` frees in a row of the most recent allocation still live, the
+ * free block left by the last of them leaves the free list and becomes
+ * `stack.top`: small allocations are carved from its front, and a free of the
+ * block just below it merges back into it, like pushes and pops of a bump
+ * pointer (no free-list update, no search). Other allocations take the normal
+ * path, until it has to extend the heap; that, and any operation that could
+ * touch `stack.top`, puts it back on the free list (`stack_leave`).
+ *
+ * Each heap has its own (saved and loaded by `heap_select`), so the ring only
+ * holds blocks of the heap it belongs to. Not for the top area of the
+ * two-ended mode or attached heaps.
+ */
+typedef struct StackPath {
+    BlockHeader *top;                   // `NULL` when the fast path is off
+    int run;                            // frees in stack order in a row
+    BlockHeader *recent[STACK_RECENT];  // last allocations not freed yet,
+    int recent_pos;                     // newest at `recent_pos - 1`
+    int recent_len;
+} StackPath;
+
+static StackPath stack;
+
+/**
+ * Heap state kept out of the globals above: the default heap while an
+ * `mm_heap_...` function works on another heap, and the heaps from
+ * `mm_heap_create` the rest of the time. Between calls, the globals (and the
+ * selected memlib heap) always describe the default heap.
+ */
+struct MmHeap {
+    MemHeap *mem;                 // memlib heap (`NULL` for the default one)
+    BlockHeader *blocks;          // `heap_blocks`
+    BlockHeader *list_head;       // `mm_list_headp`
+    BlockHeader *list_tail;       // `mm_list_tailp`
+    BlockHeader *compact_cursor;
+    Superblock *superblock;
+    int shared;
+    long allocated_bytes;
+    MmFitPolicy fit_policy;
+    int size_cache_on;
+    int bitmap_on;
+    StackPath stack;
+};
+
+static MmHeap heap_default;
+static MmHeap *heap_current = &heap_default;  // heap described by the globals
+
+/**
+ * Call-site mode (see `mm_set_site_heaps`): statistics of each allocation
+ * site, and the heaps serving them (`site_heaps[0]` is the default heap).
+ */
+typedef struct {
+    void *addr;         // return address of the call site (NULL if never used)
+    int heap;           // index of the heap serving the site
+    int allocs;         // allocations since the last heap choice
+    int frees;          // frees since the last heap choice
+    long lifetime_sum;  // lifetimes of those frees (in allocations)
+} Site;
+
+static Site sites[SITE_SLOTS];
+static MmHeap *site_heaps[MAX_SITE_HEAPS];
+static int site_heaps_len;      // 0 when the mode is off
+static int site_heaps_next;     // heaps to use from the next `mm_init`
+static unsigned site_clock;     // allocations so far
+
+/**
+ * Heap of the blocks allocated with `MM_SHORT_LIVED` (see `mm_malloc_hint`),
+ * created by the first of them and destroyed by `mm_init`.
+ */
+static MmHeap *short_heap;
+
+/**
+ * Two-ended mode (see `mm_set_two_ended`): blocks of at least `top_min_size`
+ * payload bytes come from `top_heap`, an area at the end of the memlib range
+ * that grows down (`mem_sbrk_top`), with its own free list. The area is laid
+ * out like a region between `top_lo` and `top_hi`: alignment word, prologue,
+ * blocks and epilogue; growing it moves the prologue down. Its list links are
+ * offsets from the `heap_blocks` of the default heap, in the same range.
+ */
+static MmHeap top_heap;
+static size_t top_min_size;  // 0 when the mode is off
+static size_t top_min_next;  // `top_min_size` from the next `mm_init`
+static char *top_lo;         // `NULL` until the first large block
+static char *top_hi;
+
+/**
+ * Span mode (see `mm_set_spans`): new blocks of at least `span_min_size`
+ * payload bytes are spans of whole pages from the page heap (`mm_span.c`), at
+ * the end of the memlib range.
+ */
+static size_t span_min_size;  // 0 when the mode is off
+static size_t span_min_next;  // `span_min_size` from the next `mm_init`
+
+/**
+ * Whether requests of up to 8 bytes get cells of the tiny class (see
+ * `mm_tiny.c`): only on the default heap built by `mm_init` after
+ * `mm_set_tiny(1)`, not on attached ones.
+ */
+static int tiny_on;
+static int tiny_next;  // `tiny_on` from the next `mm_init`
+
+/**
+ * Select the placement policy used by the next allocations.
+ *
+ * Meant to be called before `mm_init`, so that a whole trace is served by the
+ * same policy (this is how `mtest` builds its allocator variants).
+ *
+ * @param policy one of the `MmFitPolicy` values
+ */
+void mm_set_fit_policy(MmFitPolicy policy) {
+    fit_policy = policy;
+    fit_policy_next = policy;
+}
+
+/**
+ * Bytes in allocated blocks, including headers, footers and padding (used by
+ * `mtest` to measure internal fragmentation).
+ *
+ * @return number of bytes
+ */
+long mm_allocated_bytes(void) {
+    if (shared)
+        return superblock->allocated_bytes;
+    long bytes = allocated_bytes;
+    for (int i = 1; i < site_heaps_len; i++)
+        bytes += site_heaps[i]->allocated_bytes;
+    if (short_heap != NULL)
+        bytes += short_heap->allocated_bytes;
+    if (top_min_size != 0)
+        bytes += top_heap.allocated_bytes;
+    if (span_min_size != 0)
+        bytes += mm_span_allocated_bytes();
+    return bytes;
+}
+
+/**
+ * Bytes taken from memlib by the default heap and the call-site heaps (see
+ * `mm_set_site_heaps`).
+ *
+ * @return total heap size in bytes
+ */
+long mm_heapsize(void) {
+    long bytes = mem_heapsize();
+    for (int i = 1; i < site_heaps_len; i++) {
+        mem_select(site_heaps[i]->mem);
+        bytes += mem_heapsize();
+    }
+    if (short_heap != NULL) {
+        mem_select(short_heap->mem);
+        bytes += mem_heapsize();
+    }
+    mem_select(NULL);
+    return bytes;
+}
+
+/**
+ * Write the header of a block (and its bits in the side bitmap, if used).
+ *
+ * @param bp address of the block header
+ * @param size size in bytes (must be a multiple of 8)
+ * @param allocated either 0 or 1
+ */
+static void block_set_header(BlockHeader *bp, int size, int allocated) {
+    mm_block_set_header(bp, size, allocated);
+    if (bitmap_on)
+        mm_bitmap_set(bp, size, allocated);
+}
+
+/**
+ * Write the footer of a block, unless it is allocated and the side bitmap is
+ * used: its payload then takes the place of the footer. Free blocks keep
+ * theirs, to find their header when the next block merges into them.
+ *
+ * @param bp address of the block header
+ * @param size size in bytes (must be a multiple of 8)
+ * @param allocated either 0 or 1
+ */
+static void block_set_footer(BlockHeader *bp, int size, int allocated) {
+    if (!bitmap_on || !allocated)
+        mm_block_set_footer(bp, size, allocated);
+}
+
+/**
+ * Check whether the previous block on the heap is allocated, without reading
+ * its footer if the side bitmap is used.
+ *
+ * @param bp address of a block header
+ * @return 1 if allocated, 0 if free
+ */
+static int block_prev_allocated(BlockHeader *bp) {
+    if (bitmap_on)
+        return mm_bitmap_prev_allocated(bp);
+    return mm_block_allocated(bp - 1);  // its footer
+}
+
+/**
+ * Check whether the next block on the heap is allocated, without reading its
+ * header if the side bitmap is used.
+ *
+ * @param bp address of a block header
+ * @return 1 if allocated, 0 if free
+ */
+static int block_next_allocated(BlockHeader *bp) {
+    BlockHeader *next = mm_block_next(bp);
+    return bitmap_on ? mm_bitmap_allocated(next) : mm_block_allocated(next);
+}
+
+/**
+ * Usable bytes of an allocated block: all but the header and the footer (if
+ * any).
+ *
+ * @param bp address of an allocated block
+ * @return payload size in bytes
+ */
+static int block_payload_size(BlockHeader *bp) {
+    return mm_block_size(bp) - (bitmap_on ? 4 : 8);
+}
+
+/**
+ * Add a free block to the free list (and to the size index, if used).
+ *
+ * @param bp address of a free block, with header and footer already written
+ */
+static void free_list_add(BlockHeader *bp) {
+    mm_list_prepend(bp);
+    if (fit_policy == MM_INDEX_FIT)
+        mm_index_add(bp);
+    if (size_cache_on)
+        mm_cache_add(bp);
+}
+
+/**
+ * Remove a free block from the free list (and from the size index and the
+ * exact-size cache, if used).
+ *
+ * @param bp address of a free block, with its header still intact
+ */
+static void free_list_remove(BlockHeader *bp) {
+    mm_list_remove(bp);
+    if (fit_policy == MM_INDEX_FIT)
+        mm_index_remove(bp);
+    if (size_cache_on)
+        mm_cache_remove(bp, mm_block_size(bp));
+}
+
+/**
+ * Update the size index and the exact-size cache after the size of a listed
+ * free block changed.
+ *
+ * @param bp address of a free block, with its new header
+ * @param old_size size of the block before the change
+ */
+static void free_list_resize(BlockHeader *bp, int old_size) {
+    if (fit_policy == MM_INDEX_FIT)
+        mm_index_resize(bp);
+    if (size_cache_on) {
+        mm_cache_remove(bp, old_size);
+        mm_cache_add(bp);
+    }
+}
+
+/**
+ * Keep the compactor's cursor on a block header when the header of `gone` is
+ * merged into the block `into`.
+ */
+static void block_merged(BlockHeader *gone, BlockHeader *into) {
+    if (compact_cursor == gone)
+        compact_cursor = into;
+}
+
 /**
  * Mark a block as free, coalesce with contiguous free blocks on the heap, add
  * the coalesced block to the free list.
@@ -18,54 +397,106 @@ static BlockHeader *free_coalesce(BlockHeader *bp) {
 
     // mark block as free
     int size = mm_block_size(bp);
-    mm_block_set_header(bp, size, 0);
-    mm_block_set_footer(bp, size, 0);
+    block_set_header(bp, size, 0);
+    block_set_footer(bp, size, 0);
 
     // check whether contiguous blocks are allocated
-    int prev_alloc = mm_block_allocated(mm_block_prev(bp));
-    int next_alloc = mm_block_allocated(mm_block_next(bp));
+    int prev_alloc = block_prev_allocated(bp);
+    int next_alloc = block_next_allocated(bp);
 
     if (prev_alloc && next_alloc) {
-        // TODO: add bp to free list
-        mm_list_prepend(bp);
+        free_list_add(bp);
         return bp;
 
     } else if (prev_alloc && !next_alloc) {
-        // TODO: remove next block from free list
-        // TODO: add bp to free list
-        // TODO: coalesce with next block
+        // coalesce with next block
         size += mm_block_size(mm_block_next(bp));
-        mm_list_remove(mm_block_next(bp));
-        mm_list_prepend(bp);
-        mm_block_set_header(bp, size, 0);
-        mm_block_set_footer(bp, size, 0);
+        free_list_remove(mm_block_next(bp));
+        block_merged(mm_block_next(bp), bp);
+        block_set_header(bp, size, 0);
+        block_set_footer(bp, size, 0);
+        free_list_add(bp);
         return bp;
 
     } else if (!prev_alloc && next_alloc) {
-        // TODO: coalesce with previous block
-        size += mm_block_size(mm_block_prev(bp));
-        mm_block_set_header(mm_block_prev(bp),size, 0);
-        mm_block_set_footer(mm_block_prev(bp),size, 0);
-        return mm_block_prev(bp);
+        // coalesce with previous block (already on the free list)
+        BlockHeader *prev = mm_block_prev(bp);
+        int prev_size = mm_block_size(prev);
+        size += prev_size;
+        block_merged(bp, prev);
+        block_set_header(prev, size, 0);
+        block_set_footer(prev, size, 0);
+        free_list_resize(prev, prev_size);
+        return prev;
 
     } else {
-        // TODO: remove next block from free list
-        // TODO: coalesce with previous and next block
-        size += mm_block_size(mm_block_next(bp)) + mm_block_size(mm_block_prev(bp));
-        mm_list_remove(mm_block_next(bp));
-        mm_block_set_header(mm_block_prev(bp),size, 0);
-        mm_block_set_footer(mm_block_prev(bp),size, 0);
-        return mm_block_prev(bp);
+        // coalesce with previous and next block
+        BlockHeader *prev = mm_block_prev(bp);
+        int prev_size = mm_block_size(prev);
+        size += mm_block_size(mm_block_next(bp)) + prev_size;
+        free_list_remove(mm_block_next(bp));
+        block_merged(bp, prev);
+        block_merged(mm_block_next(bp), prev);
+        block_set_header(prev, size, 0);
+        block_set_footer(prev, size, 0);
+        free_list_resize(prev, prev_size);
+        return prev;
     }
 }
 
 /**
- * Allocate a free block of `size` byte (multiple of 8) on the heap.
+ * Map a new region holding a free block of at least `size` bytes, once
+ * `mem_sbrk` cannot grow the heap. A region is laid out like the heap itself
+ * (alignment word, prologue, blocks, epilogue), so coalescing never crosses a
+ * region boundary.
+ *
+ * @param size minimum size of the free block (a multiple of 8)
+ * @return pointer to the header of the free block, or `NULL` if out of memory
+ *         or the region is out of reach of the free-list links
+ */
+static BlockHeader *add_region(int size) {
+    long region_size = MAX(size + REGION_OVERHEAD, REGION_SIZE);
+    long bitmap_bytes = bitmap_on ? mm_bitmap_bytes(region_size) : 0;  // after the blocks
+    char *start = mem_region(region_size + bitmap_bytes);
+    if ((long)start == -1)
+        return NULL;
+
+    // links are 32-bit offsets from `heap_blocks` (the region stays with
+    // memlib until `mem_reset_brk` if it is too far)
+    if (start - (char *)heap_blocks < -(long)INT_MAX ||
+        start + region_size - (char *)heap_blocks > (long)INT_MAX)
+        return NULL;
+    if (bitmap_on && mm_bitmap_add_region(start, region_size) < 0)
+        return NULL;
+
+    BlockHeader *prologue = (BlockHeader *)start + 1;
+    block_set_header(prologue, 8, 1);
+    block_set_footer(prologue, 8, 1);
+
+    BlockHeader *bp = prologue + 2;
+    int block_size = region_size - REGION_OVERHEAD;
+    block_set_header(bp, block_size, 0);
+    block_set_footer(bp, block_size, 0);
+    block_set_header(mm_block_next(bp), 0, 1);  // epilogue
+
+    free_list_add(bp);
+    return bp;
+}
+
+/**
+ * Allocate a free block of `size` byte (multiple of 8) on the heap, or in a
+ * new region if the heap cannot grow.
  *
  * @param size number of bytes to allocate (a multiple of 8)
- * @return pointer to the header of the allocated block
+ * @return pointer to the header of the free block, or `NULL` if out of memory
  */
 static BlockHeader *extend_heap(int size) {
+    // the bitmap grows down from the top of the memlib range: cover the new
+    // block first, then check what is left for it
+    if (size > mem_brk_avail() ||
+        (bitmap_on && mm_bitmap_cover(mem_heap_hi() + 1 + size) < 0) ||
+        size > mem_brk_avail())
+        return add_region(size);
 
     // bp points to the beginning of the new block
     char *bp = mem_sbrk(size);
@@ -74,20 +505,64 @@ static BlockHeader *extend_heap(int size) {
 
     // write header over old epilogue, then the footer
     BlockHeader *old_epilogue = (BlockHeader *)bp - 1;
-    mm_block_set_header(old_epilogue, size, 0);
-    mm_block_set_footer(old_epilogue, size, 0);
+    block_set_header(old_epilogue, size, 0);
+    block_set_footer(old_epilogue, size, 0);
 
     // write new epilogue
-    mm_block_set_header(mm_block_next(old_epilogue), 0, 1);
+    block_set_header(mm_block_next(old_epilogue), 0, 1);
 
     // merge new block with previous one if possible
     return free_coalesce(old_epilogue);
 }
 
-int mm_init(void) {
+/**
+ * Check whether a block is the last one of the heap, or is only followed by
+ * a free block, so that it can grow by extending the heap.
+ *
+ * @param bp address of an allocated block
+ * @return 1 if only free space follows the block on the heap
+ */
+static int block_at_top(BlockHeader *bp) {
+    BlockHeader *epilogue = (BlockHeader *)(mem_heap_hi() - 3);
+    BlockHeader *next = mm_block_next(bp);
+    if (!mm_block_allocated(next))
+        next = mm_block_next(next);
+    return next == epilogue;
+}
+
+/**
+ * Make sure the heap ends with a free block of at least `size` bytes,
+ * extending it only by what the free block already there lacks.
+ *
+ * @param size minimum size of the free block (a multiple of 8)
+ * @return the free block at the top of the heap, or `NULL` if the heap has
+ *         reached its limit
+ */
+static BlockHeader *extend_top(int size) {
+    BlockHeader *epilogue = (BlockHeader *)(mem_heap_hi() - 3);
+    int have = block_prev_allocated(epilogue) ? 0 : mm_block_size(epilogue - 1);
+    if (have >= size)
+        return mm_block_prev(epilogue);
+    int grow = MAX(size - have, 512);  // like heap_malloc, never by less than 512
+    if (grow > mem_brk_avail())
+        return NULL;
+    return extend_heap(grow);
+}
 
+/**
+ * Build an empty heap at the current break: alignment word, prologue,
+ * epilogue and a first free block.
+ *
+ * @return 0 on success, -1 on error
+ */
+static int heap_init(void) {
     // init list of free blocks
     mm_list_init();
+    allocated_bytes = 0;
+    compact_cursor = NULL;
+    stack.top = NULL;
+    stack.run = 0;
+    stack.recent_len = 0;
 
     // create empty heap of 4 x 4-byte words
     char *new_region = mem_sbrk(16);
@@ -95,11 +570,15 @@ int mm_init(void) {
         return -1;
 
     heap_blocks = (BlockHeader *)new_region;
-    mm_block_set_header(heap_blocks, 0, 0);      // skip 4 bytes for alignment
-    mm_block_set_header(heap_blocks + 1, 8, 1);  // allocate a block of 8 bytes as prologue
-    mm_block_set_footer(heap_blocks + 1, 8, 1);
-    mm_block_set_header(heap_blocks + 3, 0, 1);  // epilogue (size 0, allocated)
+    block_set_header(heap_blocks, 0, 0);      // skip 4 bytes for alignment
+    block_set_header(heap_blocks + 1, 8, 1);  // allocate a block of 8 bytes as prologue
+    block_set_footer(heap_blocks + 1, 8, 1);
+    block_set_header(heap_blocks + 3, 0, 1);  // epilogue (size 0, allocated)
     heap_blocks += 1;                            // point to the prologue header
+    if (fit_policy == MM_INDEX_FIT)
+        mm_index_init();
+    if (size_cache_on)
+        mm_cache_init();
 
     // TODO: extend heap with an initial heap size
     extend_heap(64);
@@ -107,144 +586,1333 @@ int mm_init(void) {
     return 0;
 }
 
-void mm_free(void *bp) {
-    // TODO: move back 4 bytes to find the block header, then free block
-    if (bp == NULL) {
-        return; 
-    }
+/**
+ * Serve `mm_malloc`, `mm_realloc` and `mm_free` from several heaps chosen by
+ * call site, starting from the next `mm_init`.
+ *
+ * Objects from the same site tend to have similar lifetimes, and heaps that
+ * hold objects of similar lifetimes fragment less. Each site starts on a heap
+ * chosen by hashing its return address. Then, every 64 allocations, the site
+ * moves to the heap of its lifetime class: heap 0 for objects freed within 64
+ * allocations, heap 1 within 64^2, and so on (the last heap for sites whose
+ * objects are mostly still live). Each block keeps its site and allocation
+ * time in 4 extra bytes after the payload.
+ *
+ * Not meant for attached heaps, or with the buddy backend.
+ *
+ * @param count number of heaps (2 to 8), or 0 for a single heap (default)
+ */
+void mm_set_site_heaps(int count) {
+    site_heaps_next = (count < 2) ? 0 : MIN(count, MAX_SITE_HEAPS);
+}
 
-    BlockHeader *blockHeader = (BlockHeader *)((char *)bp - 4);
-    free_coalesce(blockHeader);
+/**
+ * Release the call-site heaps of the previous `mm_init` (call-site mode ends).
+ */
+static void site_heaps_release(void) {
+    for (int i = 1; i < site_heaps_len; i++)
+        mm_heap_destroy(site_heaps[i]);
+    site_heaps_len = 0;
+    memset(sites, 0, sizeof(sites));
+    site_clock = 0;
 }
 
 /**
- * Find a free block with size greater or equal to `size`.
+ * Release the call-site heaps of the previous `mm_init`, and create those
+ * selected by `mm_set_site_heaps`.
  *
- * @param size minimum size of the free block
- * @return pointer to the header of a free block or `NULL` if free blocks are
- *         all smaller than `size`.
+ * @return 0 on success, -1 if out of memory
  */
-static BlockHeader *find_fit(int size) {
-    // TODO: implement
-    BlockHeader *bp = mm_list_headp;
-    while (bp != NULL) {
-        if (mm_block_size(bp) >= size) {
-            return bp;
+static int site_heaps_init(void) {
+    site_heaps_release();
+    if (site_heaps_next == 0)
+        return 0;
+    site_heaps[0] = &heap_default;
+    for (int i = 1; i < site_heaps_next; i++) {
+        site_heaps[i] = mm_heap_create();
+        if (site_heaps[i] == NULL) {
+            while (--i > 0)
+                mm_heap_destroy(site_heaps[i]);
+            return -1;
         }
-        bp = mm_list_next(bp);
     }
-    return NULL;
+    site_heaps_len = site_heaps_next;
+    return 0;
 }
 
 /**
- * Allocate a block of `size` bytes inside the given free block `bp`.
+ * Grow the heap from both ends of the memlib range, from the next `mm_init`:
+ * blocks of at least `large_size` bytes are taken from the top of the range,
+ * in an area that grows down with its own free list, and smaller ones from
+ * the bottom as usual. Small and large blocks then never share a free block,
+ * so that freeing the ones does not leave slivers between the others. When
+ * the two areas meet, the free block at the end of one is given back to the
+ * other.
  *
- * @param bp pointer to the header of a free block of at least `size` bytes
- * @param size bytes to assign as an allocated block (multiple of 8)
- * @return pointer to the header of the allocated block
+ * Only for anonymous or malloc-backed heaps (with a memlib heap backed by a
+ * file, large blocks come from the bottom); not for attached heaps.
+ *
+ * @param large_size smallest payload size taken from the top, or 0 to grow
+ *        from the bottom only (default)
  */
-static BlockHeader *place(BlockHeader *bp, int size) {
-    int old_size = mm_block_size(bp);
-    int new_size = old_size - size;
+void mm_set_two_ended(size_t large_size) {
+    top_min_next = large_size;
+}
 
-    if (new_size >= 16) {
-        if (size >= 75) {
-            mm_block_set_header(bp, new_size, 1);
-            mm_block_set_footer(bp, new_size, 1);
-            BlockHeader *new_bp = mm_block_next(bp);
-            mm_block_set_header(new_bp, size, 1);
-            mm_block_set_footer(new_bp, size, 1);
-            mm_block_set_header(bp, new_size, 0);
-            mm_block_set_footer(bp, new_size, 0);
-            return new_bp;
-        }
-        else {
-        mm_block_set_header(bp, size, 1);
-        mm_block_set_footer(bp, size, 1);
-        BlockHeader *new_bp = mm_block_next(bp);
-        mm_list_prepend(new_bp);
-        mm_block_set_header(new_bp, new_size, 0);
-        mm_block_set_footer(new_bp, new_size, 0);
-        }
-    }
-    else {
-        mm_block_set_header(bp, old_size, 1);
-        mm_block_set_footer(bp, old_size, 1);
-    }
+/**
+ * Serve requests of 1 to 8 bytes from 8-byte cells with no header, from the
+ * next `mm_init` (see `mm_tiny.c`): cells are packed in 4 KB containers taken
+ * from the default heap, with their free cells on a list. Not for attached
+ * heaps, heaps from `mm_heap_create`, or call-site mode.
+ *
+ * @param on 1 to use the tiny class, 0 for ordinary blocks (default)
+ */
+void mm_set_tiny(int on) {
+    tiny_next = on;
+}
 
-    mm_list_remove(bp);
+/**
+ * Look for an exact fit in a cache of recently freed blocks before the free
+ * list, from the next `mm_init` (see `mm_cache.c`): one stack of the last free
+ * blocks of each size up to 1 KB. Blocks leave the cache when they are merged
+ * or split. Not for attached heaps or heaps from `mm_heap_create`.
+ *
+ * @param on 1 to use the cache, 0 for the free list only (default)
+ */
+void mm_set_size_cache(int on) {
+    size_cache_next = on;
+}
 
-    return bp;
+/**
+ * Keep the allocation state of the blocks of the default heap in a side
+ * bitmap, from the next `mm_init`: one bit per 8-byte granule, set at the
+ * first and last granule of each allocated block (see `mm_bitmap.c`). A free
+ * then tests two bits to know whether its neighbors are free, instead of
+ * reading the footer before it and the header after it. Allocated blocks have
+ * no footer, so they hold 4 more bytes of payload.
+ *
+ * The bitmap takes 1/64 of the heap size, at the top of the memlib range
+ * (and at the end of each extra region). Not with the two-ended mode, or for
+ * attached heaps.
+ *
+ * @param on 1 to use the bitmap, 0 for footers (default)
+ */
+void mm_set_bitmap(int on) {
+    bitmap_next = on;
 }
 
 /**
- * Compute the required block size (including space for header/footer) from the
- * requested payload size.
+ * Serve new blocks of at least `min_size` bytes from a page heap, from the
+ * next `mm_init` (see `mm_span.c`): spans of whole pages, taken from the top
+ * of the memlib range, with page-aligned payloads and no header. Free spans
+ * are coalesced and kept in lists by length, and a two-level radix map finds
+ * the span of a page, so that large blocks are allocated and freed without a
+ * walk of the free list of small blocks. A span that grows with `mm_realloc`
+ * takes the free pages after it, or moves to a new span. When the page heap
+ * and the default heap meet, the free space at the end of one is given back
+ * to the other.
  *
- * @param payload_size requested payload size
- * @return a block size including header/footer that is a multiple of 8
+ * Each span wastes what its payload leaves of its last page, so `min_size`
+ * should be several pages. Not with the two-ended or bitmap modes (which also
+ * take the top of the range), or for attached heaps; with a file-backed
+ * memlib heap, the mode stays off.
+ *
+ * @param min_size smallest payload size served by spans, or 0 for none
+ *        (default)
  */
-static int required_block_size(int payload_size) {
-    payload_size += 8;                    // add 8 for for header/footer
-    return ((payload_size + 7) / 8) * 8;  // round up to multiple of 8
+void mm_set_spans(size_t min_size) {
+    span_min_next = min_size;
 }
 
-void *mm_malloc(size_t size) {
-    // ignore spurious requests
-    if (size == 0)
-        return NULL;
+int mm_init(void) {
+    superblock = NULL;
+    shared = 0;
+    fit_policy = fit_policy_next;
+    handle_free_len = 0;
+    handle_next = 1;
+    mm_heap_destroy(short_heap);
+    short_heap = NULL;
+    if (site_heaps_init() < 0)
+        return -1;
+    size_cache_on = size_cache_next;
+    bitmap_on = bitmap_next && mm_bitmap_init(mem_heap_hi() + 1) == 0;
+    if (heap_init() < 0)
+        return -1;
 
-    int required_size = required_block_size(size);
+    top_min_size = bitmap_on ? 0 : top_min_next;
+    top_lo = NULL;
+    top_hi = NULL;
+    memset(&top_heap, 0, sizeof(top_heap));
+    top_heap.blocks = heap_blocks;
+    top_heap.fit_policy = MM_FIRST_FIT;
 
-    // TODO: find a free block or extend heap
-    // TODO: allocate and return pointer to payload
-    BlockHeader* temp = find_fit(required_size);
-    while (temp == NULL) {
-        int tempp;
-        if (required_size > 512) {
-            tempp = required_size;
-        }
-        else {
-            tempp = 512;
-        }
-        extend_heap(tempp);
-        temp = find_fit(required_size);
-    }
-    BlockHeader* result = place(temp,required_size);
-    return (BlockHeader *)((char *)result + 4);
+    span_min_size = 0;
+    if (span_min_next != 0 && !bitmap_on && top_min_size == 0 && mm_span_init(mem_heap_lo()) == 0)
+        span_min_size = span_min_next;
+
+    char *lo = mem_heap_lo();
+    tiny_on = tiny_next && mm_tiny_init(lo, mem_heap_hi() + 1 - lo + mem_brk_avail()) == 0;
+    return 0;
 }
 
-void *mm_realloc(void *ptr, size_t size) {
-    // Equivalent to malloc if ptr is NULL
-    if (ptr == NULL) {
-        return mm_malloc(size);
-    }
+/**
+ * Convert a block address to an offset from `heap_blocks`.
+ *
+ * @param bp address of a block, or `NULL`
+ * @return offset of the block, or 0 for `NULL`
+ */
+static int block_offset(void *bp) {
+    return (bp == NULL) ? 0 : (char *)bp - (char *)heap_blocks;
+}
 
-    // Equivalent to free if size is 0
-    if (size == 0) {
-        mm_free(ptr);
-        return NULL;
-    }
+/**
+ * Convert an offset from `heap_blocks` back to an address.
+ *
+ * @param offset offset of a block, or 0
+ * @return address of the block, or `NULL` for 0
+ */
+static void *block_at(int offset) {
+    return (offset == 0) ? NULL : (char *)heap_blocks + offset;
+}
 
-    BlockHeader *block_header = (BlockHeader *)((char *)ptr - 4);
-    size_t old_size = mm_block_size(block_header) - 8;
+/**
+ * Save the state of the heap in the superblock, if the heap is attached to a
+ * file (called at the end of each heap operation).
+ */
+static void superblock_sync(void) {
+    if (superblock == NULL)
+        return;
+    superblock->heap_size = mem_heapsize();
+    superblock->free_head = block_offset(mm_list_headp);
+    superblock->free_tail = block_offset(mm_list_tailp);
+    superblock->allocated_bytes = allocated_bytes;
+}
 
-    if (size <= old_size) {
+/**
+ * Read the state of the heap back from the superblock, mapping the pages that
+ * were added since the last operation (by another process).
+ */
+static void superblock_load(void) {
+    long grown = superblock->heap_size - mem_heapsize();
+    if (grown > 0)
+        mem_sbrk(grown);
+    mm_list_headp = block_at(superblock->free_head);
+    mm_list_tailp = block_at(superblock->free_tail);
+    allocated_bytes = superblock->allocated_bytes;
+}
+
+/**
+ * Start a heap operation: on a shared heap, take the lock and load the state
+ * that other processes may have changed. O(1), unless the heap has grown.
+ */
+static void heap_lock(void) {
+    if (!shared)
+        return;
+    // the previous owner died during an operation: carry on with its heap
+    if (pthread_mutex_lock(&superblock->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&superblock->lock);
+    superblock_load();
+}
+
+/**
+ * End a heap operation: save the state in the superblock (if any) and release
+ * the lock of a shared heap.
+ */
+static void heap_unlock(void) {
+    if (superblock == NULL)
+        return;
+    superblock_sync();
+    if (shared)
+        pthread_mutex_unlock(&superblock->lock);
+}
+
+/**
+ * Map the heap of a file or shared-memory object, creating an empty heap in
+ * it if it is new (see `mm_attach` and `mm_attach_shared`).
+ *
+ * @param config memlib configuration of the file or object
+ * @return 0 on success, -1 on error
+ */
+static int heap_attach(const MemConfig *config) {
+    // the call-site and short-lived heaps belong to the heap of `mm_init`
+    site_heaps_release();
+    mm_heap_destroy(short_heap);
+    short_heap = NULL;
+    mem_configure(config);
+    mem_init();
+    shared = (config->backing == MEM_BACKING_SHM);
+    size_cache_on = 0;
+    bitmap_on = 0;
+    stack.top = NULL;
+    stack.run = 0;
+    stack.recent_len = 0;
+    top_min_size = 0;
+    span_min_size = 0;
+    tiny_on = 0;
+    handle_free_len = 0;
+    handle_next = 1;
+    compact_cursor = NULL;
+
+    Superblock *sb = (Superblock *)mem_sbrk(sizeof(Superblock));
+    if ((long)sb == -1)
+        return -1;
+
+    // a shared heap is created by the first process to claim a zeroed object
+    int expected = 0;
+    int create = shared
+        ? __atomic_compare_exchange_n(&sb->magic, &expected, MM_MAGIC_BUSY, 0,
+              __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)
+        : sb->magic != MM_MAGIC;
+
+    if (create) {
+        // new heap: the magic number is written last, once the heap is valid
+        superblock = NULL;
+        if (heap_init() < 0)
+            return -1;
+        sb->blocks = (char *)heap_blocks - (char *)sb;
+        sb->root = 0;
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&sb->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+
+        superblock = sb;
+        superblock_sync();
+        __atomic_store_n(&sb->magic, MM_MAGIC, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    while (__atomic_load_n(&sb->magic, __ATOMIC_ACQUIRE) == MM_MAGIC_BUSY)
+        sched_yield();
+    if (sb->magic != MM_MAGIC)
+        return -1;
+
+    superblock = sb;
+    heap_blocks = (BlockHeader *)((char *)sb + sb->blocks);
+    if (shared) {
+        heap_lock();
+        heap_unlock();
+    } else {
+        superblock_load();
+    }
+
+    if (fit_policy == MM_INDEX_FIT) {
+        mm_index_init();
+        for (BlockHeader *bp = mm_list_headp; bp != NULL; bp = mm_list_next(bp))
+            mm_index_add(bp);
+    }
+    return 0;
+}
+
+/**
+ * Map the heap stored in a file, or create an empty heap in it if the file is
+ * new. An existing heap is usable right away: the free list, the break and
+ * the root are read back from the superblock, no block is visited (except to
+ * rebuild the size index with `MM_INDEX_FIT`).
+ *
+ * The file stays mapped until `mm_detach`, with the default memlib limit;
+ * its contents are in sync with the superblock after each `mm_malloc`,
+ * `mm_realloc` or `mm_free`.
+ *
+ * @param path heap file
+ * @return 0 on success, -1 on error
+ */
+int mm_attach(const char *path) {
+    MemConfig config = {MEM_BACKING_FILE, 0, 0, 0, path};
+    return heap_attach(&config);
+}
+
+/**
+ * Map a heap shared by several processes through a POSIX shared-memory object
+ * (see `shm_open`), creating it if needed. Each operation takes a
+ * process-shared lock stored in the superblock, then reloads the free list
+ * from it, so processes can free blocks allocated by others. Payloads are
+ * passed between processes as offsets (`mm_offset`, `mm_pointer`), since the
+ * heap may be mapped at different addresses.
+ *
+ * The size index is private to a process, so shared heaps use the free list
+ * (`MM_INDEX_FIT` falls back to first fit).
+ *
+ * @param name name of the shared-memory object (starting with '/')
+ * @return 0 on success, -1 on error
+ */
+int mm_attach_shared(const char *name) {
+    if (fit_policy == MM_INDEX_FIT)
+        fit_policy = MM_FIRST_FIT;
+    MemConfig config = {MEM_BACKING_SHM, 0, 0, 0, name};
+    return heap_attach(&config);
+}
+
+/**
+ * Unmap the heap file or shared object (see `mm_attach`). Its superblock is
+ * already up to date, and the file or object is kept.
+ */
+void mm_detach(void) {
+    if (superblock == NULL)
+        return;
+    superblock = NULL;
+    shared = 0;
+    mem_deinit();
+}
+
+/**
+ * Register the payload from which the application finds its data again after
+ * `mm_attach` (ignored unless the heap is attached to a file).
+ *
+ * @param ptr payload of an allocated block, or `NULL`
+ */
+void mm_set_root(void *ptr) {
+    if (superblock != NULL)
+        superblock->root = block_offset(ptr);
+}
+
+/**
+ * Get the payload registered with `mm_set_root`.
+ *
+ * @return the root payload, or `NULL` if none (or no heap file is attached)
+ */
+void *mm_get_root(void) {
+    return (superblock != NULL) ? block_at(superblock->root) : NULL;
+}
+
+/**
+ * Position of a payload in the heap, valid in every process that maps it.
+ *
+ * @param ptr payload of an allocated block, or `NULL`
+ * @return offset of the payload, or 0 for `NULL`
+ */
+long mm_offset(void *ptr) {
+    return block_offset(ptr);
+}
+
+/**
+ * Address of a payload in this process, from its offset.
+ *
+ * @param offset value returned by `mm_offset`
+ * @return the payload, or `NULL` for 0
+ */
+void *mm_pointer(long offset) {
+    // map the pages that another process may have added for this payload
+    if (shared && (char *)heap_blocks + offset > mem_heap_hi()) {
+        heap_lock();
+        heap_unlock();
+    }
+    return block_at(offset);
+}
+
+/**
+ * Leave the stack fast path: `stack.top` goes back on the free list, and the
+ * recent allocations are forgotten.
+ */
+static void stack_leave(void) {
+    if (stack.top != NULL)
+        free_list_add(stack.top);
+    stack.top = NULL;
+    stack.run = 0;
+    stack.recent_len = 0;
+}
+
+/**
+ * Allocate a block at the front of `stack.top`.
+ *
+ * @param size block size (a multiple of 8)
+ * @return the payload address, or `NULL` if `stack.top` is too small (the
+ *         heap is not extended here, since free blocks may fit elsewhere)
+ */
+static void *stack_push(int size) {
+    int top_size = mm_block_size(stack.top);
+    if (top_size - size < 16)
+        return NULL;
+
+    BlockHeader *bp = stack.top;
+    stack.top = (BlockHeader *)((char *)bp + size);
+    block_set_header(stack.top, top_size - size, 0);
+    block_set_footer(stack.top, top_size - size, 0);
+    block_set_header(bp, size, 1);
+    block_set_footer(bp, size, 1);
+    allocated_bytes += size;
+    return mm_block_payload_addr(bp);
+}
+
+/**
+ * Free the block just below `stack.top`, merging it into `stack.top` (with
+ * the free block before it, if any).
+ *
+ * @param bp address of an allocated block followed by `stack.top`
+ */
+static void stack_pop(BlockHeader *bp) {
+    int size = mm_block_size(bp);
+    int top_size = size + mm_block_size(stack.top);
+    block_merged(stack.top, bp);
+    allocated_bytes -= size;
+    if (!block_prev_allocated(bp)) {
+        // out of order: the previous block was freed first
+        BlockHeader *prev = mm_block_prev(bp);
+        free_list_remove(prev);
+        block_merged(bp, prev);
+        top_size += mm_block_size(prev);
+        bp = prev;
+    }
+    block_set_header(bp, top_size, 0);
+    block_set_footer(bp, top_size, 0);
+    stack.top = bp;
+}
+
+/**
+ * Remember a block allocated by the normal path.
+ *
+ * @param bp address of the allocated block
+ */
+static void stack_note_alloc(BlockHeader *bp) {
+    stack.recent[stack.recent_pos] = bp;
+    stack.recent_pos = (stack.recent_pos + 1) % STACK_RECENT;
+    stack.recent_len = MIN(stack.recent_len + 1, STACK_RECENT);
+}
+
+/**
+ * Count a free of the most recent live allocation, or break the run.
+ *
+ * @param bp address of the block being freed
+ * @return 1 if the run is long enough to start the stack path
+ */
+static int stack_note_free(BlockHeader *bp) {
+    if (stack.recent_len == 0)
+        return 0;  // deeper than the ring: neither in order nor out of order
+    int last = (stack.recent_pos + STACK_RECENT - 1) % STACK_RECENT;
+    if (stack.recent[last] != bp) {
+        stack.run = 0;
+        stack.recent_len = 0;
+        return 0;
+    }
+    stack.recent_pos = last;
+    stack.recent_len--;
+    return ++stack.run >= STACK_RUN;
+}
+
+/**
+ * Start the stack path on a free block.
+ *
+ * @param bp address of a free block (on the free list)
+ */
+static void stack_enter(BlockHeader *bp) {
+    if (heap_current == &top_heap || superblock != NULL)
+        return;
+    free_list_remove(bp);
+    stack.top = bp;
+}
+
+/**
+ * Save the globals into the state of the heap they describe, and load the
+ * state of another heap into them.
+ *
+ * @param heap heap to work on next
+ */
+static void heap_select(MmHeap *heap) {
+    if (heap == heap_current)
+        return;
+    MmHeap *old = heap_current;
+    old->blocks = heap_blocks;
+    old->list_head = mm_list_headp;
+    old->list_tail = mm_list_tailp;
+    old->compact_cursor = compact_cursor;
+    old->superblock = superblock;
+    old->shared = shared;
+    old->allocated_bytes = allocated_bytes;
+    old->fit_policy = fit_policy;
+    old->size_cache_on = size_cache_on;
+    old->bitmap_on = bitmap_on;
+    old->stack = stack;
+
+    heap_blocks = heap->blocks;
+    mm_list_headp = heap->list_head;
+    mm_list_tailp = heap->list_tail;
+    compact_cursor = heap->compact_cursor;
+    superblock = heap->superblock;
+    shared = heap->shared;
+    allocated_bytes = heap->allocated_bytes;
+    fit_policy = heap->fit_policy;
+    size_cache_on = heap->size_cache_on;
+    bitmap_on = heap->bitmap_on;
+    stack = heap->stack;
+    mem_select(heap->mem);
+    heap_current = heap;
+}
+
+/**
+ * Check whether a block is in the top area of the two-ended mode.
+ *
+ * @param bp address of a block
+ * @return 1 if the block belongs to `top_heap`, 0 otherwise
+ */
+static int block_in_top(BlockHeader *bp) {
+    return top_lo != NULL && (char *)bp > top_lo && (char *)bp < top_hi;
+}
+
+/**
+ * Give back a free block at the bottom of the top area (with `top_heap`
+ * selected), so that the default heap can grow into its space.
+ *
+ * @param bp address of the free block just after the prologue
+ */
+static void top_shrink(BlockHeader *bp) {
+    int size = mm_block_size(bp);
+    free_list_remove(bp);
+    top_lo += size;
+
+    // the new prologue takes the last 8 bytes of the block
+    BlockHeader *prologue = (BlockHeader *)top_lo + 1;
+    block_set_header(prologue - 1, 0, 0);
+    block_set_header(prologue, 8, 1);
+    block_set_footer(prologue, 8, 1);
+    mem_trim_top(size);
+}
+
+/**
+ * Free a block of the top area.
+ *
+ * @param bp address of an allocated block in the top area
+ */
+static void top_free(BlockHeader *bp) {
+    heap_select(&top_heap);
+    allocated_bytes -= mm_block_size(bp);
+    free_coalesce(bp);
+    heap_select(&heap_default);
+}
+
+/**
+ * Free a block (`mm_free` without locking).
+ *
+ * @param bp payload of an allocated block, or `NULL`
+ */
+static void heap_free(void *bp) {
+    // TODO: move back 4 bytes to find the block header, then free block
+    if (bp == NULL) {
+        return; 
+    }
+
+    if (span_min_size != 0 && mm_span_owns(bp)) {
+        mm_span_free(bp);
+        return;
+    }
+    BlockHeader *blockHeader = (BlockHeader *)((char *)bp - 4);
+    if (block_in_top(blockHeader)) {
+        top_free(blockHeader);
+        return;
+    }
+    if (tiny_on && mm_tiny_page_of(bp) != NULL) {
+        // a cell: its container is freed too if no longer used
+        allocated_bytes -= TINY_SIZE;
+        bp = mm_tiny_free(bp);
+        if (bp == NULL)
+            return;
+        blockHeader = (BlockHeader *)((char *)bp - 4);
+        allocated_bytes += mm_block_size(blockHeader);
+    }
+    if (stack.top != NULL) {
+        if (mm_block_next(blockHeader) == stack.top) {
+            stack_pop(blockHeader);
+            return;
+        }
+        if (mm_block_next(stack.top) == blockHeader)
+            stack_leave();  // would coalesce with stack.top
+    }
+    allocated_bytes -= mm_block_size(blockHeader);
+    int in_order = stack_note_free(blockHeader);
+    BlockHeader *free_bp = free_coalesce(blockHeader);
+    if (in_order && stack.top == NULL)
+        stack_enter(free_bp);
+}
+
+/**
+ * Find a free block with size greater or equal to `size`.
+ *
+ * @param size minimum size of the free block
+ * @return pointer to the header of a free block or `NULL` if free blocks are
+ *         all smaller than `size`.
+ */
+static BlockHeader *find_fit(int size) {
+    if (size_cache_on) {
+        BlockHeader *bp = mm_cache_find(size);
+        if (bp != NULL)
+            return bp;  // exact fit in O(1)
+    }
+
+    if (fit_policy == MM_INDEX_FIT && mm_index_valid())
+        return mm_index_find(size);
+
+    BlockHeader *bp = mm_list_headp;
+
+    if (fit_policy == MM_BEST_FIT) {
+        BlockHeader *best = NULL;
+        while (bp != NULL) {
+            int bp_size = mm_block_size(bp);
+            if (bp_size == size)
+                return bp;  // cannot do better than an exact fit
+            if (bp_size > size && (best == NULL || bp_size < mm_block_size(best)))
+                best = bp;
+            bp = mm_list_next(bp);
+        }
+        return best;
+    }
+
+    while (bp != NULL) {
+        if (mm_block_size(bp) >= size) {
+            return bp;
+        }
+        bp = mm_list_next(bp);
+    }
+    return NULL;
+}
+
+/**
+ * Allocate a block of `size` bytes at the start of the given free block `bp`,
+ * leaving the rest (if large enough) as a free block just after it.
+ *
+ * @param bp pointer to the header of a free block of at least `size` bytes
+ * @param size bytes to assign as an allocated block (multiple of 8)
+ * @return pointer to the header of the allocated block
+ */
+static BlockHeader *place_front(BlockHeader *bp, int size) {
+    int old_size = mm_block_size(bp);
+    int new_size = old_size - size;
+    free_list_remove(bp);
+
+    if (new_size >= 16) {
+        block_set_header(bp, size, 1);
+        block_set_footer(bp, size, 1);
+        BlockHeader *new_bp = mm_block_next(bp);
+        block_set_header(new_bp, new_size, 0);
+        block_set_footer(new_bp, new_size, 0);
+        free_list_add(new_bp);
+    }
+    else {
+        block_set_header(bp, old_size, 1);
+        block_set_footer(bp, old_size, 1);
+    }
+
+    return bp;
+}
+
+/**
+ * Allocate a block of `size` bytes inside the given free block `bp`.
+ *
+ * @param bp pointer to the header of a free block of at least `size` bytes
+ * @param size bytes to assign as an allocated block (multiple of 8)
+ * @return pointer to the header of the allocated block
+ */
+static BlockHeader *place(BlockHeader *bp, int size) {
+    int old_size = mm_block_size(bp);
+    int new_size = old_size - size;
+
+    if (new_size >= 16 && size >= 75) {
+        // large blocks go at the end, so that small ones stay together
+        block_set_header(bp, new_size, 1);
+        block_set_footer(bp, new_size, 1);
+        BlockHeader *new_bp = mm_block_next(bp);
+        block_set_header(new_bp, size, 1);
+        block_set_footer(new_bp, size, 1);
+        block_set_header(bp, new_size, 0);
+        block_set_footer(bp, new_size, 0);
+        free_list_resize(bp, old_size);
+        return new_bp;
+    }
+
+    return place_front(bp, size);
+}
+
+/**
+ * Compute the required block size (including space for header/footer) from the
+ * requested payload size.
+ *
+ * @param payload_size requested payload size
+ * @return a block size including header/footer that is a multiple of 8, and
+ *         at least 16 bytes
+ */
+static int required_block_size(int payload_size) {
+    payload_size += bitmap_on ? 4 : 8;    // add 8 for for header/footer (only a header with the bitmap)
+    int size = ((payload_size + 7) / 8) * 8;  // round up to multiple of 8
+    return MAX(size, 16);                 // room for the links and footer once free
+}
+
+/**
+ * Grow the top area down by `size` bytes, with `top_heap` selected: a new
+ * alignment word and prologue, and a free block up to the old lowest block
+ * (merged with it if free).
+ *
+ * @param size bytes to add (a multiple of 8)
+ * @return the free block at the bottom of the area, or `NULL` if the area
+ *         would cross the break of the default heap
+ */
+static BlockHeader *top_grow(int size) {
+    int overhead = (top_lo == NULL) ? 16 : 0;  // first time: also an epilogue
+    char *lo = mem_sbrk_top(size + overhead);
+    if ((long)lo == -1)
+        return NULL;
+    if (top_lo == NULL) {
+        top_hi = lo + size + overhead;
+        block_set_header((BlockHeader *)top_hi - 1, 0, 1);  // epilogue
+    }
+    top_lo = lo;
+
+    BlockHeader *prologue = (BlockHeader *)lo + 1;
+    block_set_header(prologue - 1, 0, 0);  // alignment
+    block_set_header(prologue, 8, 1);
+    block_set_footer(prologue, 8, 1);
+    block_set_header(prologue + 2, size, 0);
+    return free_coalesce(prologue + 2);
+}
+
+/**
+ * Find a free block in the top area, growing it by what its lowest block
+ * lacks if none fits (with `top_heap` selected).
+ *
+ * @param size block size (a multiple of 8)
+ * @return the free block, or `NULL` if the area cannot grow
+ */
+static BlockHeader *top_fit(int size) {
+    BlockHeader *bp = find_fit(size);
+    if (bp != NULL)
+        return bp;
+    int have = 0;
+    if (top_lo != NULL) {
+        BlockHeader *first = (BlockHeader *)(top_lo + 12);
+        if (!mm_block_allocated(first))
+            have = mm_block_size(first);
+    }
+    return top_grow(MAX(size - have, 512));  // like heap_malloc, never by less than 512
+}
+
+/**
+ * Give back the free block at the end of the default heap, so that the top
+ * area can grow into its space (with the default heap selected).
+ *
+ * @return 1 if the break moved down, 0 if the last block is allocated
+ */
+static int bottom_release(void) {
+    BlockHeader *epilogue = (BlockHeader *)(mem_heap_hi() - 3);
+    BlockHeader *last = (BlockHeader *)((char *)epilogue - mm_block_size(epilogue - 1));
+    if (mm_block_allocated(last))
+        return 0;
+    int size = mm_block_size(last);
+    free_list_remove(last);
+    block_set_header(last, 0, 1);  // new epilogue
+    mem_trim(size);
+    return 1;
+}
+
+/**
+ * Allocate a block in the top area.
+ *
+ * @param size block size (a multiple of 8)
+ * @return the payload address, or `NULL` if neither area has room
+ */
+static void *top_malloc(int size) {
+    heap_select(&top_heap);
+    BlockHeader *bp = top_fit(size);
+    if (bp == NULL) {
+        // the areas met: take the free space at the end of the default heap
+        heap_select(&heap_default);
+        if (!bottom_release())
+            return NULL;
+        heap_select(&top_heap);
+        bp = top_fit(size);
+    }
+    void *ptr = NULL;
+    if (bp != NULL) {
+        BlockHeader *result = place(bp, size);  // at the end: the rest stays low
+        allocated_bytes += mm_block_size(result);
+        ptr = mm_block_payload_addr(result);
+    }
+    heap_select(&heap_default);
+    return ptr;
+}
+
+/**
+ * Allocate a block (`mm_malloc` without locking).
+ *
+ * @param size payload size in bytes
+ * @return the payload address, or `NULL` if out of memory
+ */
+static void *heap_malloc(size_t size) {
+    // ignore spurious requests
+    if (size == 0)
+        return NULL;
+
+    int required_size = required_block_size(size);
+    if (stack.top != NULL && required_size < 75 && (!size_cache_on || mm_cache_find(required_size) == NULL)) {
+        void *ptr = stack_push(required_size);
+        if (ptr != NULL)
+            return ptr;
+    }
+
+    // TODO: find a free block or extend heap
+    // TODO: allocate and return pointer to payload
+    BlockHeader* temp = find_fit(required_size);
+    if (temp == NULL && stack.top != NULL) {
+        stack_leave();  // the heap is extended at its top, which may be `stack.top`
+        temp = find_fit(required_size);
+    }
+    while (temp == NULL) {
+        int tempp;
+        if (required_size > 512) {
+            tempp = required_size;
+        }
+        else {
+            tempp = 512;
+        }
+        if (top_lo != NULL && heap_current == &heap_default && tempp > mem_brk_avail()) {
+            // the areas met: take the free space at the bottom of the top area
+            heap_select(&top_heap);
+            BlockHeader *first = (BlockHeader *)(top_lo + 12);
+            if (!mm_block_allocated(first))
+                top_shrink(first);
+            heap_select(&heap_default);
+        }
+        if (span_min_size != 0 && heap_current == &heap_default && tempp > mem_brk_avail())
+            mm_span_release();  // the areas met: take the free pages at the bottom of the page heap
+        if (extend_heap(tempp) == NULL)
+            return NULL;
+        temp = find_fit(required_size);
+    }
+    BlockHeader* result = place(temp,required_size);
+    allocated_bytes += mm_block_size(result);
+    stack_note_alloc(result);
+    return (BlockHeader *)((char *)result + 4);
+}
+
+/**
+ * Allocate a cell of the tiny class, taking a new container from the heap if
+ * all are full. Containers are not counted as allocated bytes, only cells.
+ *
+ * @return the cell address, or `NULL` if out of memory or the container
+ *         cannot be mapped by the tiny class
+ */
+static void *tiny_malloc(void) {
+    void *ptr = mm_tiny_alloc();
+    if (ptr == NULL) {
+        char *page = heap_malloc(TINY_PAGE_BYTES);
+        if (page == NULL)
+            return NULL;
+        if (mm_tiny_add_page(page) < 0) {
+            heap_free(page);  // the map cannot grow to it
+            return NULL;
+        }
+        allocated_bytes -= mm_block_size((BlockHeader *)(page - 4));
+        ptr = mm_tiny_alloc();
+    }
+    allocated_bytes += TINY_SIZE;
+    return ptr;
+}
+
+/**
+ * Allocate a span of the page heap (with the default heap selected).
+ *
+ * @param size payload size in bytes
+ * @return the payload address, or `NULL` if neither heap has room
+ */
+static void *span_malloc(size_t size) {
+    void *ptr = mm_span_alloc(size);
+    if (ptr == NULL) {
+        // the heaps met: take the free space at the end of the default heap
+        stack_leave();
+        if (bottom_release())
+            ptr = mm_span_alloc(size);
+    }
+    return ptr;
+}
+
+/**
+ * Allocate a new block in the class of its size: a cell of the tiny class for
+ * up to 8 bytes, a block of the top area for large ones in two-ended mode (see
+ * `mm_set_two_ended`), a span in span mode (see `mm_set_spans`), else like
+ * `heap_malloc`. Only for new blocks: blocks that grow with `mm_realloc` stay
+ * at the bottom, which grows in place.
+ *
+ * @param size payload size in bytes
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+static void *class_malloc(size_t size) {
+    if (tiny_on && size != 0 && size <= TINY_SIZE) {
+        void *ptr = tiny_malloc();
+        if (ptr != NULL)
+            return ptr;
+    }
+    if (top_min_size != 0 && size >= top_min_size) {
+        void *ptr = top_malloc(required_block_size(size));
+        if (ptr != NULL)
+            return ptr;
+    }
+    if (span_min_size != 0 && size >= span_min_size) {
+        void *ptr = span_malloc(size);
+        if (ptr != NULL)
+            return ptr;
+    }
+    return heap_malloc(size);
+}
+
+/**
+ * Find the free block at the lowest address that is large enough.
+ *
+ * @param size block size in bytes
+ * @param below only consider free blocks before this address
+ * @return the free block, or `NULL` if none
+ */
+static BlockHeader *lowest_fit(int size, BlockHeader *below) {
+    BlockHeader *target = NULL;
+    for (BlockHeader *fp = mm_list_headp; fp != NULL; fp = mm_list_next(fp)) {
+        if (fp < below && (target == NULL || fp < target) && mm_block_size(fp) >= size)
+            target = fp;
+    }
+    return target;
+}
+
+/**
+ * Allocate a block as low in the heap as possible (`MM_LONG_LIVED`), at the
+ * front of the lowest free block that fits.
+ *
+ * @param size payload size in bytes
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+static void *heap_malloc_low(size_t size) {
+    if (size == 0)
+        return NULL;
+    stack_leave();
+    int required_size = required_block_size(size);
+    BlockHeader *target = lowest_fit(required_size, (BlockHeader *)UINTPTR_MAX);
+    if (target == NULL)
+        return heap_malloc(size);
+    BlockHeader *bp = place_front(target, required_size);
+    allocated_bytes += mm_block_size(bp);
+    return mm_block_payload_addr(bp);
+}
+
+/**
+ * Find a free block with room for a block of `size` bytes whose payload is
+ * aligned to `align`, and the address of that payload: at the start of the
+ * free block if it is aligned, else far enough in to leave a free block of at
+ * least 16 bytes before it.
+ *
+ * @param size block size in bytes
+ * @param align alignment of the payload (a power of 2, more than 8)
+ * @param payload set to the aligned payload address in the block found
+ * @return the free block, or `NULL` if none has room
+ */
+static BlockHeader *aligned_fit(int size, size_t align, char **payload) {
+    for (BlockHeader *fp = mm_list_headp; fp != NULL; fp = mm_list_next(fp)) {
+        char *start = mm_block_payload_addr(fp);
+        char *aligned = (char *)(((uintptr_t)start + align - 1) & ~(uintptr_t)(align - 1));
+        if (aligned != start && aligned - start < 16)
+            aligned += align;
+        if (aligned - start + size <= mm_block_size(fp)) {
+            *payload = aligned;
+            return fp;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Allocate a block whose payload is aligned to `align` bytes (`mm_malloc_aligned`
+ * without locking), carved out of a free block: the space before and after it
+ * stays free. If no free block has room, a block large enough to hold an
+ * aligned one is allocated and freed first, which grows the heap as
+ * `heap_malloc` does.
+ *
+ * @param size payload size in bytes
+ * @param align alignment of the payload (a power of 2)
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+static void *heap_malloc_aligned(size_t size, size_t align) {
+    if (align <= 8)
+        return heap_malloc(size);
+    if (size == 0)
+        return NULL;
+    stack_leave();  // `stack.top` is not on the free list
+    int required_size = required_block_size(size);
+    char *payload;
+    BlockHeader *fp = aligned_fit(required_size, align, &payload);
+    if (fp == NULL) {
+        void *room = heap_malloc(size + align + 16);
+        if (room == NULL)
+            return NULL;
+        heap_free(room);
+        fp = aligned_fit(required_size, align, &payload);
+        if (fp == NULL)
+            return NULL;
+    }
+
+    int lead = payload - mm_block_payload_addr(fp);
+    int tail = mm_block_size(fp) - lead - required_size;
+    free_list_remove(fp);
+    if (lead != 0) {
+        block_set_header(fp, lead, 0);
+        block_set_footer(fp, lead, 0);
+        free_list_add(fp);
+    }
+    BlockHeader *bp = (BlockHeader *)(payload - 4);
+    if (tail < 16) {
+        required_size += tail;
+    } else {
+        BlockHeader *rest = (BlockHeader *)((char *)bp + required_size);
+        block_set_header(rest, tail, 0);
+        block_set_footer(rest, tail, 0);
+        free_list_add(rest);
+    }
+    block_set_header(bp, required_size, 1);
+    block_set_footer(bp, required_size, 1);
+    allocated_bytes += required_size;
+    return payload;
+}
+
+/**
+ * Resize a block of the top area: in place if it is large enough or the next
+ * block is free and large enough, else by moving it to the bottom.
+ *
+ * @param bp address of an allocated block in the top area
+ * @param size new payload size in bytes (not 0)
+ * @return the payload address, or `NULL` if out of memory
+ */
+static void *top_realloc(BlockHeader *bp, size_t size) {
+    void *ptr = mm_block_payload_addr(bp);
+    size_t old_size = mm_block_size(bp) - 8;
+    if (size <= old_size)
+        return ptr;
+
+    heap_select(&top_heap);
+    BlockHeader *next = mm_block_next(bp);
+    size_t combined_size = mm_block_size(bp) + mm_block_size(next);
+    int in_place = !mm_block_allocated(next) && combined_size - 8 >= size;
+    if (in_place) {
+        free_list_remove(next);
+        allocated_bytes += mm_block_size(next);
+        block_set_header(bp, combined_size, 1);
+        block_set_footer(bp, combined_size, 1);
+    }
+    heap_select(&heap_default);
+    if (in_place)
+        return ptr;
+
+    void *new_ptr = heap_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    top_free(bp);
+    return new_ptr;
+}
+
+/**
+ * Resize a span: in place if its pages (and the free pages after it) are
+ * enough, else by moving it to a new block.
+ *
+ * @param ptr payload of an allocated span
+ * @param size new payload size in bytes (not 0)
+ * @return the payload address, or `NULL` if out of memory
+ */
+static void *span_realloc(void *ptr, size_t size) {
+    if (mm_span_resize(ptr, size) == 0)
         return ptr;
+    void *new_ptr = class_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, mm_span_size(ptr));
+    mm_span_free(ptr);
+    return new_ptr;
+}
+
+/**
+ * Move a large payload to a new block by remapping its whole pages (see
+ * `mem_remap`) and copying only the bytes before the first and after the last
+ * page boundary. The new block is placed at the same offset within a page as
+ * the old one, so that pages line up.
+ *
+ * @param ptr payload of an allocated block
+ * @param old_size bytes of the payload to preserve
+ * @param size new payload size (greater than `old_size`)
+ * @return the new payload address, or `NULL` if out of memory
+ */
+static void *realloc_remap(void *ptr, size_t old_size, size_t size) {
+    long page = sysconf(_SC_PAGESIZE);
+
+    // over-allocate by a page (plus room for a leading free block), then split
+    char *big = heap_malloc(size + page + 16);
+    if (big == NULL)
+        return NULL;
+    BlockHeader *bp = (BlockHeader *)(big - 4);
+    int big_size = mm_block_size(bp);
+    int lead = ((uintptr_t)ptr - (uintptr_t)big) & (page - 1);
+    if (lead < 16)
+        lead += page;
+
+    BlockHeader *new_bp = (BlockHeader *)((char *)bp + lead);
+    block_set_header(new_bp, big_size - lead, 1);
+    block_set_footer(new_bp, big_size - lead, 1);
+    block_set_header(bp, lead, 1);
+    block_set_footer(bp, lead, 1);
+    heap_free(big);
+
+    // give back the unused tail
+    int required_size = required_block_size(size);
+    int tail = mm_block_size(new_bp) - required_size;
+    if (tail >= 16) {
+        block_set_header(new_bp, required_size, 1);
+        block_set_footer(new_bp, required_size, 1);
+        BlockHeader *tail_bp = mm_block_next(new_bp);
+        block_set_header(tail_bp, tail, 1);
+        allocated_bytes -= tail;
+        free_coalesce(tail_bp);
+    }
+
+    char *src = ptr;
+    char *dst = mm_block_payload_addr(new_bp);
+    long head = (-(uintptr_t)src) & (page - 1);
+    long pages = (old_size > (size_t)head) ? (old_size - head) & ~(page - 1) : 0;
+    if (pages == 0 || mem_remap(dst + head, src + head, pages) < 0) {
+        memcpy(dst, src, old_size);
+    } else {
+        memcpy(dst, src, head);
+        memcpy(dst + head + pages, src + head + pages, old_size - head - pages);
+    }
+
+    heap_free(ptr);
+    return dst;
+}
+
+/**
+ * Find the smallest free block below `below` that is large enough (the lowest
+ * one on a tie), among the first `RELOCATE_CANDIDATES` blocks of the free
+ * list only, so that a shrinking realloc stays cheap on a long list.
+ *
+ * @param size block size in bytes
+ * @param below only consider free blocks before this address
+ * @return the free block, or `NULL` if none
+ */
+static BlockHeader *relocate_fit(int size, BlockHeader *below) {
+    BlockHeader *target = NULL;
+    BlockHeader *fp = mm_list_headp;
+    for (int i = 0; fp != NULL && i < RELOCATE_CANDIDATES; i++, fp = mm_list_next(fp)) {
+        int fp_size = mm_block_size(fp);
+        if (fp >= below || fp_size < size)
+            continue;
+        if (target == NULL || fp_size < mm_block_size(target) ||
+            (fp_size == mm_block_size(target) && fp < target))
+            target = fp;
+    }
+    return target;
+}
+
+/**
+ * Move a shrinking block to a free block below it where it fits, when free
+ * space is over 1/4 of the heap: the vacated block can then coalesce with its
+ * neighbors, and free space gathers at the top of the heap. Growing blocks are
+ * not moved down, since the space after them is their room to grow.
+ *
+ * @param bp address of an allocated block
+ * @param size new payload size
+ * @return the new payload address, or `NULL` if the block was not moved
+ */
+static void *realloc_relocate(BlockHeader *bp, size_t size) {
+    long heap_size = mem_heapsize();
+    if ((heap_size - allocated_bytes) * RELOCATE_FREE_RATIO < heap_size)
+        return NULL;
+
+    int required_size = required_block_size(size);
+    BlockHeader *target = relocate_fit(required_size, bp);
+    if (target == NULL)
+        return NULL;
+
+    // at the front of the free block, so that the rest is room to grow
+    size_t old_size = block_payload_size(bp);
+    BlockHeader *new_bp = place_front(target, required_size);
+    allocated_bytes += mm_block_size(new_bp);
+    memcpy(mm_block_payload_addr(new_bp), mm_block_payload_addr(bp), MIN(old_size, size));
+    heap_free(mm_block_payload_addr(bp));
+    return mm_block_payload_addr(new_bp);
+}
+
+/**
+ * Resize a block (`mm_realloc` without locking).
+ *
+ * @param ptr payload of an allocated block, or `NULL`
+ * @param size new payload size in bytes
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+static void *heap_realloc(void *ptr, size_t size) {
+    stack_leave();
+    // Equivalent to malloc if ptr is NULL
+    if (ptr == NULL) {
+        return heap_malloc(size);
+    }
+
+    // Equivalent to free if size is 0
+    if (size == 0) {
+        heap_free(ptr);
+        return NULL;
+    }
+
+    if (span_min_size != 0 && mm_span_owns(ptr))
+        return span_realloc(ptr, size);
+    BlockHeader *block_header = (BlockHeader *)((char *)ptr - 4);
+    if (block_in_top(block_header))
+        return top_realloc(block_header, size);
+    if (tiny_on && mm_tiny_page_of(ptr) != NULL) {
+        if (size <= TINY_SIZE)
+            return ptr;
+        void *new_ptr = heap_malloc(size);
+        if (new_ptr != NULL) {
+            memcpy(new_ptr, ptr, TINY_SIZE);
+            heap_free(ptr);
+        }
+        return new_ptr;
+    }
+    size_t old_size = block_payload_size(block_header);
+
+    if (size <= old_size) {
+        // a block that grew is likely to grow again: never moved down
+        if (mm_block_grown(block_header))
+            return ptr;
+        void *new_ptr = realloc_relocate(block_header, size);
+        return (new_ptr != NULL) ? new_ptr : ptr;
     }
 
+    // at the top of the heap: extend it, then grow in place
+    if (block_at_top(block_header))
+        extend_top(required_block_size(size) - mm_block_size(block_header));
     BlockHeader *next_block = mm_block_next(block_header);
     if (!mm_block_allocated(next_block)) {
         size_t combined_size = mm_block_size(block_header) + mm_block_size(next_block);
-        if (combined_size - 8 >= size) {
-            mm_list_remove(next_block);
-            mm_block_set_header(block_header, combined_size, 1);
-            mm_block_set_footer(block_header, combined_size, 1);
+        if (combined_size >= (size_t)required_block_size(size)) {
+            free_list_remove(next_block);
+            block_merged(next_block, block_header);
+            allocated_bytes += mm_block_size(next_block);
+            block_set_header(block_header, combined_size, 1);
+            block_set_footer(block_header, combined_size, 1);
+            mm_block_set_grown(block_header);
             return ptr;
         }
     }
 
-    void *new_ptr = mm_malloc(size);
+    if (old_size >= REMAP_THRESHOLD && mem_can_remap()) {
+        void *new_ptr = realloc_remap(ptr, old_size, size);
+        if (new_ptr != NULL)
+            mm_block_set_grown((BlockHeader *)((char *)new_ptr - 4));
+        return new_ptr;
+    }
+
+    // moved again after growing: to the top of the heap, where the next
+    // reallocations grow in place
+    void *new_ptr = NULL;
+    int required_size = required_block_size(size);
+    BlockHeader *top = mm_block_grown(block_header) ? extend_top(required_size) : NULL;
+    if (top != NULL) {
+        BlockHeader *new_bp = place(top, required_size);
+        allocated_bytes += mm_block_size(new_bp);
+        new_ptr = mm_block_payload_addr(new_bp);
+    } else {
+        new_ptr = heap_malloc(size);
+    }
     if (new_ptr == NULL) {
         return NULL;
     }
@@ -256,8 +1924,505 @@ void *mm_realloc(void *ptr, size_t size) {
         tempp = old_size;
     }
     memcpy(new_ptr, ptr, tempp);
-    mm_free(ptr);
-    
+    heap_free(ptr);
+
+    mm_block_set_grown((BlockHeader *)((char *)new_ptr - 4));
+    return new_ptr;
+}
+
+/**
+ * Create a heap separate from the default one, with its own memlib heap
+ * (anonymous memory, default limit). Its blocks are allocated and freed with
+ * the `mm_heap_...` functions, and all released at once by `mm_heap_destroy`.
+ *
+ * The size index is only kept for the default heap: with `MM_INDEX_FIT`, other
+ * heaps use first fit. Handles are only available on the default heap.
+ *
+ * @return the new heap, or `NULL` if out of memory
+ */
+MmHeap *mm_heap_create(void) {
+    MmHeap *heap = calloc(1, sizeof(MmHeap));
+    if (heap == NULL)
+        return NULL;
+    MemConfig config = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    heap->mem = mem_create(&config);
+    if (heap->mem == NULL) {
+        free(heap);
+        return NULL;
+    }
+    heap->fit_policy = (fit_policy == MM_INDEX_FIT) ? MM_FIRST_FIT : fit_policy;
+
+    heap_select(heap);
+    mem_init();
+    int result = heap_init();
+    heap_select(&heap_default);
+    if (result < 0) {
+        mm_heap_destroy(heap);
+        return NULL;
+    }
+    return heap;
+}
+
+/**
+ * Allocate a block on a heap from `mm_heap_create`.
+ *
+ * @param heap heap to allocate from
+ * @param size payload size in bytes
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+void *mm_heap_malloc(MmHeap *heap, size_t size) {
+    heap_select(heap);
+    void *ptr = heap_malloc(size);
+    heap_select(&heap_default);
+    return ptr;
+}
+
+/**
+ * Resize a block of a heap from `mm_heap_create`.
+ *
+ * @param heap heap of the block
+ * @param ptr payload of an allocated block, or `NULL`
+ * @param size new payload size in bytes
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+void *mm_heap_realloc(MmHeap *heap, void *ptr, size_t size) {
+    heap_select(heap);
+    void *new_ptr = heap_realloc(ptr, size);
+    heap_select(&heap_default);
+    return new_ptr;
+}
+
+/**
+ * Free a block of a heap from `mm_heap_create`.
+ *
+ * @param heap heap of the block
+ * @param ptr payload of an allocated block, or `NULL`
+ */
+void mm_heap_free(MmHeap *heap, void *ptr) {
+    heap_select(heap);
+    heap_free(ptr);
+    heap_select(&heap_default);
+}
+
+/**
+ * Release a heap from `mm_heap_create` with all its blocks, giving its memory
+ * back to the OS at once.
+ *
+ * @param heap heap to destroy, or `NULL`
+ */
+void mm_heap_destroy(MmHeap *heap) {
+    if (heap == NULL)
+        return;
+    mem_destroy(heap->mem);
+    free(heap);
+}
+
+/**
+ * Site and allocation time of a block, in its last payload word (the top bits
+ * hold the site slot, the others the allocation clock).
+ */
+static unsigned *block_site(BlockHeader *bp) {
+    return (unsigned *)(mm_block_payload_addr(bp) + block_payload_size(bp) - 4);
+}
+
+/**
+ * Check whether a payload lies in the memory of a created heap.
+ *
+ * @param heap heap from `mm_heap_create`
+ * @param ptr payload of an allocated block
+ * @return 1 if the heap holds the payload, 0 otherwise
+ */
+static int heap_holds(MmHeap *heap, void *ptr) {
+    mem_select(heap->mem);
+    int result = mem_contains(ptr, ptr);
+    mem_select(NULL);
+    return result;
+}
+
+/**
+ * Find the heap holding a payload.
+ *
+ * @param ptr payload of an allocated block
+ * @return the heap among `site_heaps`
+ */
+static MmHeap *site_heap_of(void *ptr) {
+    for (int i = 1; i < site_heaps_len; i++) {
+        if (heap_holds(site_heaps[i], ptr))
+            return site_heaps[i];
+    }
+    return &heap_default;
+}
+
+/**
+ * Choose the heap of a site from the lifetimes observed since the last choice.
+ *
+ * @param site site to update
+ */
+static void site_adapt(Site *site) {
+    int heap = site_heaps_len - 1;  // mostly live objects
+    if (site->frees >= site->allocs / 2) {
+        long lifetime = site->lifetime_sum / site->frees;
+        heap = 0;
+        while (heap < site_heaps_len - 1 && lifetime >= (1L << SITE_CLASS_BITS)) {
+            lifetime >>= SITE_CLASS_BITS;
+            heap++;
+        }
+    }
+    site->heap = heap;
+    site->allocs = 0;
+    site->frees = 0;
+    site->lifetime_sum = 0;
+}
+
+/**
+ * Allocate a block on the heap of a call site (`mm_malloc` in call-site mode).
+ *
+ * @param size payload size in bytes
+ * @param align alignment of the payload (a power of 2, or 0 for 8)
+ * @param addr return address of the call site
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+static void *site_malloc(size_t size, size_t align, void *addr) {
+    if (size == 0)
+        return NULL;
+    int slot = ((uintptr_t)addr >> 2) % SITE_SLOTS;
+    Site *site = &sites[slot];
+    if (site->addr == NULL) {
+        site->addr = addr;
+        site->heap = ((uintptr_t)addr >> 4) % site_heaps_len;
+    }
+    if (++site->allocs == SITE_ADAPT)
+        site_adapt(site);
+
+    heap_select(site_heaps[site->heap]);
+    char *ptr = heap_malloc_aligned(size + 4, align);
+    if (ptr != NULL)
+        *block_site((BlockHeader *)(ptr - 4)) = (slot << SITE_TICK_BITS) | (site_clock & ((1 << SITE_TICK_BITS) - 1));
+    heap_select(&heap_default);
+    site_clock++;
+    return ptr;
+}
+
+/**
+ * Free a block in call-site mode (`mm_free`), recording its lifetime.
+ *
+ * @param ptr payload of an allocated block, or `NULL`
+ */
+static void site_free(void *ptr) {
+    if (ptr == NULL)
+        return;
+    unsigned tag = *block_site((BlockHeader *)((char *)ptr - 4));
+    Site *site = &sites[tag >> SITE_TICK_BITS];
+    site->frees++;
+    site->lifetime_sum += (site_clock - tag) & ((1 << SITE_TICK_BITS) - 1);
+
+    heap_select(site_heap_of(ptr));
+    heap_free(ptr);
+    heap_select(&heap_default);
+}
+
+/**
+ * Resize a block in call-site mode (`mm_realloc`): it stays on its heap, and
+ * keeps its site and allocation time.
+ *
+ * @param ptr payload of an allocated block, or `NULL`
+ * @param size new payload size in bytes
+ * @param addr return address of the call site
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+static void *site_realloc(void *ptr, size_t size, void *addr) {
+    if (ptr == NULL)
+        return site_malloc(size, 0, addr);
+    if (size == 0) {
+        site_free(ptr);
+        return NULL;
+    }
+    unsigned tag = *block_site((BlockHeader *)((char *)ptr - 4));
+    heap_select(site_heap_of(ptr));
+    char *new_ptr = heap_realloc(ptr, size + 4);
+    if (new_ptr != NULL)
+        *block_site((BlockHeader *)(new_ptr - 4)) = tag;
+    heap_select(&heap_default);
     return new_ptr;
 }
 
+/**
+ * Free a block of the short-lived heap. Once its last block is freed, the heap
+ * starts over from an empty break, so that it never keeps the holes or extra
+ * regions of a past peak.
+ *
+ * @param ptr payload of a block allocated with `MM_SHORT_LIVED`
+ */
+static void short_free(void *ptr) {
+    heap_select(short_heap);
+    heap_free(ptr);
+    if (allocated_bytes == 0) {
+        mem_reset_brk();
+        heap_init();
+    }
+    heap_select(&heap_default);
+}
+
+void *mm_malloc(size_t size) {
+    if (site_heaps_len > 0)
+        return site_malloc(size, 0, __builtin_return_address(0));
+    heap_lock();
+    void *ptr = class_malloc(size);
+    heap_unlock();
+    return ptr;
+}
+
+void *mm_realloc(void *ptr, size_t size) {
+    if (site_heaps_len > 0)
+        return site_realloc(ptr, size, __builtin_return_address(0));
+    if (short_heap != NULL && ptr != NULL && heap_holds(short_heap, ptr)) {
+        if (size == 0) {
+            short_free(ptr);
+            return NULL;
+        }
+        return mm_heap_realloc(short_heap, ptr, size);
+    }
+    heap_lock();
+    ptr = heap_realloc(ptr, size);
+    heap_unlock();
+    return ptr;
+}
+
+void mm_free(void *ptr) {
+    if (site_heaps_len > 0) {
+        site_free(ptr);
+        return;
+    }
+    if (short_heap != NULL && ptr != NULL && heap_holds(short_heap, ptr)) {
+        short_free(ptr);
+        return;
+    }
+    heap_lock();
+    heap_free(ptr);
+    heap_unlock();
+}
+
+/**
+ * Allocate a block whose payload is aligned to `align` bytes. It is carved
+ * from a free block, with the space before it left free, so that blocks of a
+ * size just under their alignment tile the heap. The block is resized and
+ * freed with `mm_realloc` and `mm_free` as usual (a resized block may lose
+ * its alignment).
+ *
+ * @param size payload size in bytes
+ * @param align alignment of the payload (a power of 2)
+ * @return the payload address, or `NULL` if out of memory, `size` is 0 or
+ *         `align` is not a power of 2
+ */
+void *mm_malloc_aligned(size_t size, size_t align) {
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    if (site_heaps_len > 0)
+        return site_malloc(size, align, __builtin_return_address(0));
+    heap_lock();
+    void *ptr = heap_malloc_aligned(size, align);
+    heap_unlock();
+    return ptr;
+}
+
+/**
+ * Allocate a block with a hint about its lifetime; the block is then resized
+ * and freed with `mm_realloc` and `mm_free` as usual.
+ *
+ * Short-lived blocks go to a heap of their own, so that they do not leave
+ * holes between the blocks that stay: that heap empties and coalesces
+ * completely between bursts, and starts over once empty. Long-lived blocks
+ * are packed at the bottom of the default heap, at the front of the lowest
+ * free block that fits, away from the churn near the top.
+ *
+ * Without a hint, and in call-site mode (which finds lifetimes by itself),
+ * this is `mm_malloc`. Attached heaps only honor `MM_LONG_LIVED`.
+ *
+ * @param size payload size in bytes
+ * @param hint `MM_SHORT_LIVED`, `MM_LONG_LIVED`, or 0 for no hint
+ * @return the payload address, or `NULL` if out of memory or `size` is 0
+ */
+void *mm_malloc_hint(size_t size, int hint) {
+    if (site_heaps_len > 0)
+        return site_malloc(size, 0, __builtin_return_address(0));
+    if (hint == MM_SHORT_LIVED && superblock == NULL) {
+        if (short_heap == NULL)
+            short_heap = mm_heap_create();
+        if (short_heap != NULL)
+            return mm_heap_malloc(short_heap, size);
+    }
+    heap_lock();
+    void *ptr = (hint == MM_LONG_LIVED) ? heap_malloc_low(size) : class_malloc(size);
+    heap_unlock();
+    return ptr;
+}
+
+/**
+ * Check whether a payload lies in the memory of its heap: the default heap,
+ * or the call-site or short-lived heap that holds it.
+ *
+ * @param lo address of the first byte of the payload
+ * @param hi address of the last byte of the payload
+ * @return 1 if the whole payload is in a heap, 0 otherwise
+ */
+int mm_contains(void *lo, void *hi) {
+    MmHeap *heap = &heap_default;
+    if (short_heap != NULL && heap_holds(short_heap, lo))
+        heap = short_heap;
+    else if (site_heaps_len > 0)
+        heap = site_heap_of(lo);
+    mem_select(heap->mem);
+    int result = mem_contains(lo, hi);
+    mem_select(NULL);
+    return result;
+}
+
+/**
+ * Handle stored in the last word of the payload of a block owned by a handle.
+ *
+ * @param bp address of a movable block
+ * @return address of the handle
+ */
+static MmHandle *block_handle(BlockHeader *bp) {
+    return (MmHandle *)(mm_block_payload_addr(bp) + block_payload_size(bp) - 4);
+}
+
+/**
+ * Allocate a block that the compactor may move: it is reached through the
+ * returned handle (see `mm_hderef`), not through a pointer. Not on an attached
+ * heap: the handle table is not saved in the superblock, so blocks would keep
+ * handles that new ones reuse after the heap is attached again (or by another
+ * process).
+ *
+ * @param size payload size in bytes
+ * @return a handle, or 0 if out of memory (or handles), or the heap is
+ *         attached
+ */
+MmHandle mm_halloc(size_t size) {
+    if (size == 0 || superblock != NULL || (handle_free_len == 0 && handle_next == MAX_HANDLES))
+        return 0;
+
+    heap_lock();
+    // 4 more bytes, for the handle (found by the compactor from the block)
+    char *ptr = heap_malloc(size + 4);
+    MmHandle h = 0;
+    if (ptr != NULL) {
+        h = (handle_free_len > 0) ? handle_free[--handle_free_len] : handle_next++;
+        BlockHeader *bp = (BlockHeader *)(ptr - 4);
+        mm_block_set_movable(bp);
+        *block_handle(bp) = h;
+        handle_blocks[h] = block_offset(bp);
+    }
+    heap_unlock();
+    return h;
+}
+
+/**
+ * Get the current address of the payload of a handle. The address is valid
+ * until the next `mm_compact`.
+ *
+ * @param h handle returned by `mm_halloc`, or 0
+ * @return the payload, or `NULL` for 0
+ */
+void *mm_hderef(MmHandle h) {
+    return (h == 0) ? NULL : mm_block_payload_addr(block_at(handle_blocks[h]));
+}
+
+/**
+ * Free the block of a handle, and the handle.
+ *
+ * @param h handle returned by `mm_halloc`, or 0
+ */
+void mm_hfree(MmHandle h) {
+    if (h == 0)
+        return;
+    heap_lock();
+    heap_free(mm_hderef(h));
+    handle_free[handle_free_len++] = h;
+    heap_unlock();
+}
+
+/**
+ * Move a movable block down into the free block just before it, so that the
+ * free space moves up.
+ *
+ * @param free_bp address of a free block
+ * @param bp address of the movable block following `free_bp`
+ * @return the free block after the moved block (coalesced with the next one)
+ */
+static BlockHeader *slide_down(BlockHeader *free_bp, BlockHeader *bp) {
+    int free_size = mm_block_size(free_bp);
+    int size = mm_block_size(bp);
+
+    // header, payload, handle and footer all move
+    free_list_remove(free_bp);
+    memmove(free_bp, bp, size);
+    handle_blocks[*block_handle(free_bp)] = block_offset(free_bp);
+    if (bitmap_on)
+        mm_bitmap_set(free_bp, size, 1);
+
+    BlockHeader *hole = (BlockHeader *)((char *)free_bp + size);
+    block_set_header(hole, free_size, 0);
+    block_set_footer(hole, free_size, 0);
+    return free_coalesce(hole);
+}
+
+/**
+ * Give back the free block at the top of the heap, if it is large enough (and
+ * not at the end of an extra region).
+ *
+ * @param bp address of the free block just before the epilogue
+ */
+static void trim_top(BlockHeader *bp) {
+    int size = mm_block_size(bp);
+    if (size < TRIM_THRESHOLD || (char *)mm_block_next(bp) != mem_heap_hi() - 3)
+        return;
+    free_list_remove(bp);
+    block_set_header(bp, 0, 1);  // new epilogue
+    mem_trim(size);
+}
+
+/**
+ * Run the compactor incrementally: resume from the last block visited, slide
+ * movable blocks down over free blocks (so that free space accumulates at the
+ * top of the heap), step over the others, and trim the heap at the end of a
+ * pass. Each call stops once `budget` bytes have been moved (a block that is
+ * stepped over counts as 16 bytes).
+ *
+ * Blocks allocated with `mm_malloc` never move; they only stop free space
+ * from reaching the top. A shared heap is never compacted: the handle table
+ * is private to each process, so the others could not find their blocks.
+ *
+ * @param budget amount of work for this call, in bytes
+ * @return 1 if this call finished a pass over the heap, 0 otherwise, -1 on a
+ *         shared heap
+ */
+int mm_compact(size_t budget) {
+    if (shared)
+        return -1;
+    heap_lock();
+    stack_leave();
+    BlockHeader *bp = (compact_cursor != NULL) ? compact_cursor : mm_block_next(heap_blocks);
+    size_t work = 0;
+    int done = 0;
+
+    while (!done && work < budget) {
+        BlockHeader *next = mm_block_next(bp);
+        if (mm_block_size(bp) == 0) {
+            done = 1;  // epilogue
+        } else if (!mm_block_allocated(bp) && mm_block_size(next) == 0) {
+            trim_top(bp);
+            done = 1;
+        } else if (mm_block_allocated(bp) || !mm_block_movable(next)) {
+            bp = next;  // free blocks are never followed by free blocks
+            work += COMPACT_SKIP_COST;
+        } else {
+            work += mm_block_size(next);
+            bp = slide_down(bp, next);
+        }
+    }
+
+    compact_cursor = done ? NULL : bp;
+    heap_unlock();
+    return done;
+}
@@ -7,5 +7,69 @@ int   mm_init(void);
 void *mm_malloc(size_t size);
 void *mm_realloc(void *ptr, size_t size);
 void  mm_free(void *ptr);
+void *mm_malloc_aligned(size_t size, size_t align);
+
+/**
+ * Expected lifetime of a block, see `mm_malloc_hint`.
+ */
+typedef enum {
+    MM_SHORT_LIVED = 1,  // freed soon: on a heap of its own
+    MM_LONG_LIVED = 2,   // kept long: packed at the bottom of the heap
+} MmLifetime;
+
+void *mm_malloc_hint(size_t size, int hint);
+
+// persistent heap in a file, or heap shared between processes (see mm.c)
+int   mm_attach(const char *path);
+int   mm_attach_shared(const char *name);
+void  mm_detach(void);
+void  mm_set_root(void *ptr);
+void *mm_get_root(void);
+long  mm_offset(void *ptr);
+void *mm_pointer(long offset);
+
+/**
+ * Placement policies used by `find_fit` (set before `mm_init`).
+ */
+typedef enum {
+    MM_FIRST_FIT,  // first free block large enough (default)
+    MM_BEST_FIT,   // smallest free block large enough
+    MM_INDEX_FIT,  // first block large enough in the packed size index (SIMD)
+} MmFitPolicy;
+
+void  mm_set_fit_policy(MmFitPolicy policy);
+void  mm_set_size_cache(int on);
+void  mm_set_tiny(int on);
+void  mm_set_two_ended(size_t large_size);
+void  mm_set_bitmap(int on);
+void  mm_set_spans(size_t min_size);
+
+/**
+ * Handle of a relocatable block (0 for none), see `mm_halloc`.
+ */
+typedef int MmHandle;
+
+MmHandle mm_halloc(size_t size);
+void    *mm_hderef(MmHandle h);
+void     mm_hfree(MmHandle h);
+int      mm_compact(size_t budget);
+
+long  mm_allocated_bytes(void);
+long  mm_heapsize(void);
+int   mm_contains(void *lo, void *hi);
+
+// heaps chosen by call site (see mm.c), from the next mm_init
+void  mm_set_site_heaps(int count);
+
+/**
+ * Heap separate from the default one used by the functions above.
+ */
+typedef struct MmHeap MmHeap;
+
+MmHeap *mm_heap_create(void);
+void   *mm_heap_malloc(MmHeap *heap, size_t size);
+void   *mm_heap_realloc(MmHeap *heap, void *ptr, size_t size);
+void    mm_heap_free(MmHeap *heap, void *ptr);
+void    mm_heap_destroy(MmHeap *heap);
 
 #endif /* __MM_H__ */
@@ -0,0 +1,157 @@
+#include "mm_arena.h"  // prototypes of functions implemented in this file
+#include "mm.h"        // mm_malloc, mm_free -- chunks come from the mm heap
+#include <stddef.h>    // NULL
+
+/*
+ * An arena hands out memory by bumping a pointer inside its current chunk:
+ * objects have no header, and are never freed one by one. Chunks are taken
+ * from the mm heap with `mm_malloc` and linked newest first, so that
+ * `mm_arena_reset` and `mm_arena_destroy` give them back with one `mm_free`
+ * per chunk, whatever the number of objects.
+ *
+ * Requests over a quarter of the chunk size get a chunk of their own, linked
+ * after the current chunk, so that they do not waste the rest of it.
+ */
+
+#define ARENA_CHUNK_SIZE 4096  // default bytes per chunk (after its header)
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;  // older chunk, or NULL
+    size_t size;              // bytes after the header (a multiple of 8)
+} ArenaChunk;
+
+struct MmArena {
+    ArenaChunk *chunks;  // current chunk first, or NULL
+    char *next;          // first free byte of the current chunk
+    char *end;           // end of the current chunk
+    size_t chunk_size;
+};
+
+static char *chunk_data(ArenaChunk *chunk) {
+    return (char *)(chunk + 1);  // the header keeps the data 8-byte aligned
+}
+
+/**
+ * Take a new chunk from the mm heap.
+ *
+ * @param size bytes after the chunk header
+ * @return the chunk, or `NULL` if out of memory
+ */
+static ArenaChunk *chunk_new(size_t size) {
+    ArenaChunk *chunk = mm_malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = NULL;
+    chunk->size = size;
+    return chunk;
+}
+
+/**
+ * Give back a list of chunks to the mm heap.
+ *
+ * @param chunk first chunk of the list, or `NULL`
+ */
+static void chunk_free_all(ArenaChunk *chunk) {
+    while (chunk != NULL) {
+        ArenaChunk *next = chunk->next;
+        mm_free(chunk);
+        chunk = next;
+    }
+}
+
+/**
+ * Create an empty arena (its first chunk is taken by the first allocation).
+ *
+ * @param chunk_size bytes per chunk, or 0 for the default (4 KB)
+ * @return the arena, or `NULL` if out of memory
+ */
+MmArena *mm_arena_create(size_t chunk_size) {
+    MmArena *arena = mm_malloc(sizeof(MmArena));
+    if (arena == NULL)
+        return NULL;
+    if (chunk_size == 0)
+        chunk_size = ARENA_CHUNK_SIZE;
+    arena->chunks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->chunk_size = (chunk_size + 7) & ~(size_t)7;
+    return arena;
+}
+
+/**
+ * Allocate memory that lives until the next `mm_arena_reset` or
+ * `mm_arena_destroy` of the arena.
+ *
+ * @param arena arena to allocate from
+ * @param size payload size in bytes
+ * @return an 8-byte aligned address, or `NULL` if out of memory or `size` is 0
+ */
+void *mm_arena_alloc(MmArena *arena, size_t size) {
+    if (size == 0)
+        return NULL;
+    size = (size + 7) & ~(size_t)7;
+
+    // fast path: bump the pointer
+    if (size <= (size_t)(arena->end - arena->next)) {
+        char *ptr = arena->next;
+        arena->next += size;
+        return ptr;
+    }
+
+    if (size > arena->chunk_size / 4) {
+        ArenaChunk *chunk = chunk_new(size);
+        if (chunk == NULL)
+            return NULL;
+        if (arena->chunks == NULL) {
+            arena->chunks = chunk;
+        } else {
+            chunk->next = arena->chunks->next;
+            arena->chunks->next = chunk;
+        }
+        return chunk_data(chunk);
+    }
+
+    ArenaChunk *chunk = chunk_new(arena->chunk_size);
+    if (chunk == NULL)
+        return NULL;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = chunk_data(chunk) + size;
+    arena->end = chunk_data(chunk) + chunk->size;
+    return chunk_data(chunk);
+}
+
+/**
+ * Free all objects of the arena at once. The current chunk is kept for the
+ * next allocations; the other chunks go back to the mm heap.
+ *
+ * @param arena arena to empty
+ */
+void mm_arena_reset(MmArena *arena) {
+    ArenaChunk *current = arena->chunks;
+    if (current == NULL)
+        return;
+    if (arena->end != chunk_data(current) + current->size) {
+        // only large chunks so far: keep none
+        chunk_free_all(current);
+        arena->chunks = NULL;
+        arena->next = NULL;
+        arena->end = NULL;
+        return;
+    }
+    chunk_free_all(current->next);
+    current->next = NULL;
+    arena->next = chunk_data(current);
+}
+
+/**
+ * Free all objects of the arena and the arena itself.
+ *
+ * @param arena arena to destroy, or `NULL`
+ */
+void mm_arena_destroy(MmArena *arena) {
+    if (arena == NULL)
+        return;
+    chunk_free_all(arena->chunks);
+    mm_free(arena);
+}
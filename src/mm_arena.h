@@ -0,0 +1,16 @@
+#ifndef __MM_ARENA_H__
+#define __MM_ARENA_H__
+
+#include <stddef.h>  // size_t
+
+/**
+ * Arena of objects freed all at once, in chunks taken from the mm heap.
+ */
+typedef struct MmArena MmArena;
+
+MmArena *mm_arena_create(size_t chunk_size);
+void    *mm_arena_alloc(MmArena *arena, size_t size);
+void     mm_arena_reset(MmArena *arena);
+void     mm_arena_destroy(MmArena *arena);
+
+#endif /* __MM_ARENA_H__ */
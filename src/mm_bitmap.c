@@ -0,0 +1,202 @@
+#include <mm_bitmap.h>  // prototypes of functions implemented in this file
+#include <memlib.h>     // mem_sbrk_top -- the bitmap is next to the heap
+#include <stdint.h>     // uint64_t, uintptr_t
+#include <string.h>     // memset
+
+/*
+ * Boundary tags make each free look at its neighbors: the footer of the
+ * previous block and the header of the next one, in two other cache lines.
+ * The bitmap holds what a free needs to know out of band. Block headers are 4
+ * bytes before an 8-byte aligned payload, so a granule of 8 bytes holds at
+ * most one header: granule `g` starts with the header at `base + 4 + 8 * g`.
+ *
+ * The bit of a granule is set if it is the first or the last granule of an
+ * allocated block. So the block after `bp` is allocated if the bit of its
+ * first granule is set, and the block before `bp` if the bit of the granule
+ * just before `bp` is set: two bit tests, usually in the same word. Bits of
+ * the other granules are never read, so they need not be cleared when blocks
+ * are merged or split: every header write sets both bits of its block.
+ *
+ * A word holds the bits of 512 bytes of heap, and a cache line those of 4 KB.
+ * Words are stored from the top of the memlib range down (word `i` is at
+ * `end - i - 1`), in memory taken with `mem_sbrk_top`: the bitmap grows with
+ * the heap, by 1/64 of its size, and counts in `mem_heapsize`.
+ *
+ * Extra regions (mapped once the heap reaches the memlib limit) have a bitmap
+ * of their own, in the same layout, at the end of the region. A block outside
+ * the heap range is looked up in the regions one by one, so the heap itself
+ * pays one range check.
+ */
+
+#define BITMAP_GROW 64     // bytes added at a time (a cache line, 4 KB of heap)
+#define MAX_REGIONS 1024   // as in memlib
+
+typedef struct {
+    char *base;      // `granule 0` starts at `base + 4`
+    uint64_t *end;   // just after word 0
+    long words;      // words available
+} Bitmap;
+
+static Bitmap bitmap;                     // of the heap
+static Bitmap region_maps[MAX_REGIONS];  // of the extra regions
+static int regions_len;
+
+/**
+ * Start an empty bitmap for a heap whose first block header is at `base + 4`.
+ *
+ * @param base the memlib break where the heap starts (8-byte aligned)
+ * @return 0 on success, -1 if memlib has no top part (file-backed heap) or
+ *         is full
+ */
+int mm_bitmap_init(char *base) {
+    bitmap.base = base;
+    bitmap.words = 0;
+    regions_len = 0;
+    char *area = mem_sbrk_top(BITMAP_GROW);
+    if ((long)area == -1)
+        return -1;
+    bitmap.end = (uint64_t *)(area + BITMAP_GROW);
+    memset(area, 0, BITMAP_GROW);
+    bitmap.words = BITMAP_GROW / 8;
+    return 0;
+}
+
+/**
+ * Grow the bitmap so that it covers the heap up to `hi`.
+ *
+ * @param hi first address after the heap
+ * @return 0 on success, -1 if memlib is full
+ */
+int mm_bitmap_cover(char *hi) {
+    long words = ((uintptr_t)(hi - bitmap.base) / 8 + 63) / 64;
+    if (words <= bitmap.words)
+        return 0;
+
+    long bytes = (words - bitmap.words) * 8;
+    bytes = (bytes + BITMAP_GROW - 1) / BITMAP_GROW * BITMAP_GROW;
+    char *lo = (char *)(bitmap.end - bitmap.words);
+    char *area = mem_sbrk_top(bytes);
+    if ((long)area == -1)
+        return -1;
+    if (area + bytes != lo) {
+        mem_trim_top(bytes);  // something else took the top part in between
+        return -1;
+    }
+    memset(area, 0, bytes);  // left over from before a `mem_reset_brk`
+    bitmap.words += bytes / 8;
+    return 0;
+}
+
+/**
+ * Bytes of bitmap that cover a region.
+ *
+ * @param size size of the region in bytes
+ * @return size of its bitmap in bytes (a multiple of 8)
+ */
+long mm_bitmap_bytes(long size) {
+    return (size / 8 + 63) / 64 * 8;
+}
+
+/**
+ * Start an empty bitmap for an extra region, stored just after it.
+ *
+ * @param base start of the region (8-byte aligned), followed by
+ *        `mm_bitmap_bytes(size)` bytes for the bitmap
+ * @param size size of the region in bytes
+ * @return 0 on success, -1 if there are too many regions
+ */
+int mm_bitmap_add_region(char *base, long size) {
+    if (regions_len == MAX_REGIONS)
+        return -1;
+    Bitmap *map = &region_maps[regions_len++];
+    map->base = base;
+    map->words = mm_bitmap_bytes(size) / 8;
+    map->end = (uint64_t *)(base + size) + map->words;
+    memset(base + size, 0, map->words * 8);
+    return 0;
+}
+
+/**
+ * Find the bitmap that covers an address.
+ *
+ * @param addr address in the heap or in an extra region
+ * @return the bitmap of the heap, or of the region holding `addr`
+ */
+static Bitmap *bitmap_of(char *addr) {
+    if ((uintptr_t)(addr - bitmap.base) < (uintptr_t)bitmap.words * 512)
+        return &bitmap;
+    for (int i = 0; i < regions_len; i++) {
+        if ((uintptr_t)(addr - region_maps[i].base) < (uintptr_t)region_maps[i].words * 512)
+            return &region_maps[i];
+    }
+    return &bitmap;  // the heap, past the covered part: never read
+}
+
+/**
+ * Write the bit of a granule.
+ *
+ * @param map bitmap holding the granule
+ * @param g index of the granule
+ * @param bit either 0 or 1
+ */
+static void granule_set(Bitmap *map, uintptr_t g, int bit) {
+    uint64_t *word = map->end - g / 64 - 1;
+    uint64_t mask = (uint64_t)1 << (g % 64);
+    if (bit)
+        *word |= mask;
+    else
+        *word &= ~mask;
+}
+
+/**
+ * Read the bit of a granule.
+ *
+ * @param map bitmap holding the granule
+ * @param g index of the granule
+ * @return either 0 or 1
+ */
+static int granule_get(Bitmap *map, uintptr_t g) {
+    return (map->end[-(long)(g / 64) - 1] >> (g % 64)) & 1;
+}
+
+/**
+ * Record a block header: set or clear the bits of its first and last
+ * granule. Alignment words (4 bytes before a granule) are ignored.
+ *
+ * @param bp address of the block header (in the covered part of the heap)
+ * @param size size of the block in bytes (a multiple of 8, or 0 for the
+ *        epilogue)
+ * @param allocated either 0 or 1
+ */
+void mm_bitmap_set(BlockHeader *bp, int size, int allocated) {
+    Bitmap *map = bitmap_of((char *)bp);
+    uintptr_t offset = (char *)bp - map->base;
+    if (offset % 8 != 4)
+        return;
+    granule_set(map, offset / 8, allocated);
+    if (size > 8)
+        granule_set(map, offset / 8 + size / 8 - 1, allocated);
+}
+
+/**
+ * Read whether a block is allocated, without reading its header.
+ *
+ * @param bp address of a block header
+ * @return allocated bit (either 0 or 1)
+ */
+int mm_bitmap_allocated(BlockHeader *bp) {
+    Bitmap *map = bitmap_of((char *)bp);
+    return granule_get(map, (uintptr_t)((char *)bp - map->base) / 8);
+}
+
+/**
+ * Read whether the block before `bp` is allocated, without reading its
+ * footer (or finding its header).
+ *
+ * @param bp address of a block header (not the prologue)
+ * @return allocated bit of the previous block (either 0 or 1)
+ */
+int mm_bitmap_prev_allocated(BlockHeader *bp) {
+    Bitmap *map = bitmap_of((char *)bp);
+    return granule_get(map, (uintptr_t)((char *)bp - map->base) / 8 - 1);
+}
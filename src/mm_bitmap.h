@@ -0,0 +1,19 @@
+#ifndef __MM_BITMAP_H__
+#define __MM_BITMAP_H__
+
+#include <mm_block.h>  // BlockHeader
+
+/**
+ * Side bitmap of the allocated blocks of the default heap, one bit per 8-byte
+ * granule, kept at the top of the memlib range (growing down as the heap
+ * grows up), and at the end of each extra region.
+ */
+int  mm_bitmap_init(char *base);
+int  mm_bitmap_cover(char *hi);
+long mm_bitmap_bytes(long size);
+int  mm_bitmap_add_region(char *base, long size);
+void mm_bitmap_set(BlockHeader *bp, int size, int allocated);
+int  mm_bitmap_allocated(BlockHeader *bp);
+int  mm_bitmap_prev_allocated(BlockHeader *bp);
+
+#endif /* __MM_BITMAP_H__ */
@@ -26,6 +26,48 @@ int mm_block_allocated(BlockHeader *bp) {
     return (*bp) & 1;   // get last bit
 }
 
+/**
+ * Read the movable bit (bit 1) from a block header: set on allocated blocks
+ * owned by a handle, which the compactor may move.
+ *
+ * @param bp address of the block header
+ * @return movable bit (either 0 or 1)
+ */
+int mm_block_movable(BlockHeader *bp) {
+    return ((*bp) >> 1) & 1;
+}
+
+/**
+ * Set the movable bit in the header of an allocated block (cleared by the
+ * next `mm_block_set_header`).
+ *
+ * @param bp address of the block header
+ */
+void mm_block_set_movable(BlockHeader *bp) {
+    *bp |= 2;
+}
+
+/**
+ * Read the grown bit (bit 2) from a block header: set on allocated blocks that
+ * `mm_realloc` made larger.
+ *
+ * @param bp address of the block header
+ * @return grown bit (either 0 or 1)
+ */
+int mm_block_grown(BlockHeader *bp) {
+    return ((*bp) >> 2) & 1;
+}
+
+/**
+ * Set the grown bit in the header of an allocated block (cleared by the next
+ * `mm_block_set_header`).
+ *
+ * @param bp address of the block header
+ */
+void mm_block_set_grown(BlockHeader *bp) {
+    *bp |= 4;
+}
+
 /**
  * Write the size and allocated bit of a given block inside its header.
  *
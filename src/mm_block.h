@@ -5,6 +5,8 @@
  * A block header uses 4 bytes for:
  * - a block size, multiple of 8 (so, the last 3 bits are always 0's)
  * - an allocated bit (stored as LSB, since the last 3 bits are not needed)
+ * - a movable bit (bit 1, header only) for blocks owned by a handle
+ * - a grown bit (bit 2, header only) for blocks enlarged by `mm_realloc`
  *
  * A block footer has the same format.
  * Check Figure 9.48(a) in the textbook.
@@ -18,6 +20,10 @@ extern BlockHeader *heap_blocks;
 
 int mm_block_size(BlockHeader *bp);
 int mm_block_allocated(BlockHeader *bp);
+int mm_block_movable(BlockHeader *bp);
+void mm_block_set_movable(BlockHeader *bp);
+int mm_block_grown(BlockHeader *bp);
+void mm_block_set_grown(BlockHeader *bp);
 void mm_block_set_header(BlockHeader *bp, int size, int allocated);
 void mm_block_set_footer(BlockHeader *bp, int size, int allocated);
 char *mm_block_payload_addr(BlockHeader *bp);
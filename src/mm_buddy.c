@@ -0,0 +1,392 @@
+#include "mm_buddy.h"  // prototypes of functions implemented in this file
+#include "mm.h"        // the mm.h API, with `make BACKEND=buddy`
+#include "memlib.h"    // mem_sbrk -- to extend the heap
+#include <string.h>    // memcpy -- to copy regions of memory
+
+#define MIN(x, y) ((x) > (y) ? (y) : (x))
+
+/*
+ * The heap is one block of 2^buddy_order bytes, split in halves on demand.
+ * A block of order k has 2^k bytes and starts at an offset (from buddy_base)
+ * that is a multiple of 2^k, so its buddy is at offset `off ^ (1 << k)`: no
+ * boundary tags are needed to find the neighbor to coalesce with.
+ *
+ * Each block starts with a 4-byte header holding its order and the allocated
+ * bit; free blocks also hold the offsets of the previous/next free blocks of
+ * the same order (one doubly-linked free list per order).
+ */
+
+#define BUDDY_MIN_ORDER 4    // 16 bytes: header and two links
+#define BUDDY_INIT_ORDER 12  // 4 KB heap after init
+#define BUDDY_MAX_ORDER 30
+#define BUDDY_NONE (-1)      // null offset
+
+typedef struct {
+    int header;     // order << 1 | allocated
+    int prev_free;  // offset of the previous free block of the same order
+    int next_free;  // offset of the next free block of the same order
+} BuddyBlock;
+
+/**
+ * Address of the block at offset 0 (4 bytes past an 8-byte boundary, so that
+ * payloads after the header are aligned to 8 bytes).
+ */
+static char *buddy_base;
+
+/**
+ * The whole heap is a block of order `buddy_order`.
+ */
+static int buddy_order;
+
+/**
+ * Offset of the first free block of each order.
+ */
+static int buddy_free[BUDDY_MAX_ORDER + 1];
+
+/**
+ * Bytes in allocated blocks (including headers).
+ */
+static long buddy_allocated;
+
+static BuddyBlock *buddy_block(int off) {
+    return (BuddyBlock *)(buddy_base + off);
+}
+
+/**
+ * Add a block at the beginning of the free list of its order.
+ *
+ * @param off offset of the block
+ * @param order order of the block
+ */
+static void buddy_push(int off, int order) {
+    BuddyBlock *b = buddy_block(off);
+    b->header = order << 1;
+    b->prev_free = BUDDY_NONE;
+    b->next_free = buddy_free[order];
+    if (buddy_free[order] != BUDDY_NONE)
+        buddy_block(buddy_free[order])->prev_free = off;
+    buddy_free[order] = off;
+}
+
+/**
+ * Remove a block from the free list of its order.
+ *
+ * @param off offset of the block
+ * @param order order of the block
+ */
+static void buddy_remove(int off, int order) {
+    BuddyBlock *b = buddy_block(off);
+    if (b->prev_free != BUDDY_NONE)
+        buddy_block(b->prev_free)->next_free = b->next_free;
+    else
+        buddy_free[order] = b->next_free;
+    if (b->next_free != BUDDY_NONE)
+        buddy_block(b->next_free)->prev_free = b->prev_free;
+}
+
+/**
+ * Merge a free block with its buddy as long as the buddy is free and whole,
+ * then add the result to the free list of its order.
+ *
+ * @param off offset of the free block
+ * @param order order of the free block
+ */
+static void buddy_release(int off, int order) {
+    while (order < buddy_order) {
+        int buddy = off ^ (1 << order);
+        if (buddy_block(buddy)->header != (order << 1))  // allocated, or split
+            break;
+        buddy_remove(buddy, order);
+        off = MIN(off, buddy);
+        order++;
+    }
+    buddy_push(off, order);
+}
+
+/**
+ * Double the heap: the new upper half is the buddy of the current heap.
+ *
+ * @return 0 on success, -1 if the heap cannot grow
+ */
+static int buddy_grow(void) {
+    if (buddy_order == BUDDY_MAX_ORDER)
+        return -1;
+    if ((long)mem_sbrk(1 << buddy_order) == -1)
+        return -1;
+    int off = 1 << buddy_order;
+    buddy_order++;
+    buddy_release(off, buddy_order - 1);
+    return 0;
+}
+
+/**
+ * Compute the order of the smallest block with room for the header and a
+ * payload of `size` bytes.
+ *
+ * @param size requested payload size
+ * @return order of the block, or -1 if larger than the maximum order
+ */
+static int buddy_required_order(size_t size) {
+    int order = BUDDY_MIN_ORDER;
+    while ((1UL << order) < size + 4) {
+        if (++order > BUDDY_MAX_ORDER)
+            return -1;
+    }
+    return order;
+}
+
+int mm_buddy_init(void) {
+    char *pad = mem_sbrk(4);
+    if ((long)pad == -1 || (long)mem_sbrk(1 << BUDDY_INIT_ORDER) == -1)
+        return -1;
+
+    buddy_base = pad + 4;
+    buddy_order = BUDDY_INIT_ORDER;
+    buddy_allocated = 0;
+    for (int k = 0; k <= BUDDY_MAX_ORDER; k++)
+        buddy_free[k] = BUDDY_NONE;
+    buddy_push(0, buddy_order);
+    return 0;
+}
+
+void *mm_buddy_malloc(size_t size) {
+    if (size == 0)
+        return NULL;
+
+    int order = buddy_required_order(size);
+    if (order < 0)
+        return NULL;
+
+    // smallest non-empty order that fits, doubling the heap if needed
+    int k = order;
+    while (k <= buddy_order && buddy_free[k] == BUDDY_NONE)
+        k++;
+    while (k > buddy_order) {
+        if (buddy_grow() < 0)
+            return NULL;
+        for (k = order; k <= buddy_order && buddy_free[k] == BUDDY_NONE; k++)
+            ;
+    }
+
+    // split down to the requested order, freeing the upper halves
+    int off = buddy_free[k];
+    buddy_remove(off, k);
+    while (k > order) {
+        k--;
+        buddy_push(off + (1 << k), k);
+    }
+
+    buddy_block(off)->header = (order << 1) | 1;
+    buddy_allocated += 1 << order;
+    return buddy_base + off + 4;
+}
+
+void mm_buddy_free(void *ptr) {
+    if (ptr == NULL)
+        return;
+
+    int off = (char *)ptr - 4 - buddy_base;
+    int order = buddy_block(off)->header >> 1;
+    buddy_allocated -= 1 << order;
+    buddy_release(off, order);
+}
+
+void *mm_buddy_realloc(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return mm_buddy_malloc(size);
+    if (size == 0) {
+        mm_buddy_free(ptr);
+        return NULL;
+    }
+
+    int off = (char *)ptr - 4 - buddy_base;
+    int order = buddy_block(off)->header >> 1;
+    size_t capacity = (1UL << order) - 4;
+    if (size <= capacity)
+        return ptr;
+
+    // grow in place if the upper buddies (up to the required order) are free
+    int new_order = buddy_required_order(size);
+    if (new_order > 0 && (off & ((1 << new_order) - 1)) == 0 && new_order <= buddy_order) {
+        int k = order;
+        while (k < new_order && buddy_block(off + (1 << k))->header == (k << 1))
+            k++;
+        if (k == new_order) {
+            for (k = order; k < new_order; k++)
+                buddy_remove(off + (1 << k), k);
+            buddy_block(off)->header = (new_order << 1) | 1;
+            buddy_allocated += (1L << new_order) - (1L << order);
+            return ptr;
+        }
+    }
+
+    void *new_ptr = mm_buddy_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, capacity);
+    mm_buddy_free(ptr);
+    return new_ptr;
+}
+
+/**
+ * Bytes in allocated blocks, including headers and the unused part of each
+ * power-of-two block (used by `mtest` to measure internal fragmentation).
+ *
+ * @return number of bytes
+ */
+long mm_buddy_allocated_bytes(void) {
+    return buddy_allocated;
+}
+
+#ifdef MM_BACKEND_BUDDY
+/*
+ * With `make BACKEND=buddy`, this file is built instead of `mm.c` and serves
+ * the `mm.h` API. What needs boundary tags or a heap of its own is not
+ * available: attached heaps and created heaps fail, handles are never
+ * allocated, and the modes and policies set before `mm_init` are ignored.
+ * Payloads are 4 bytes past their block, so alignments above 8 fail (and
+ * `mm_pool.c` with them).
+ */
+
+static void *buddy_root;  // see `mm_set_root`
+
+int mm_init(void) {
+    buddy_root = NULL;
+    return mm_buddy_init();
+}
+
+void *mm_malloc(size_t size) {
+    return mm_buddy_malloc(size);
+}
+
+void *mm_realloc(void *ptr, size_t size) {
+    return mm_buddy_realloc(ptr, size);
+}
+
+void mm_free(void *ptr) {
+    mm_buddy_free(ptr);
+}
+
+void *mm_malloc_aligned(size_t size, size_t align) {
+    return (align <= 8) ? mm_buddy_malloc(size) : NULL;
+}
+
+void *mm_malloc_hint(size_t size, int hint) {
+    (void)hint;
+    return mm_buddy_malloc(size);
+}
+
+int mm_attach(const char *path) {
+    (void)path;
+    return -1;  // the free lists are in static memory, not in the heap
+}
+
+int mm_attach_shared(const char *name) {
+    (void)name;
+    return -1;
+}
+
+void mm_detach(void) {
+}
+
+void mm_set_root(void *ptr) {
+    buddy_root = ptr;
+}
+
+void *mm_get_root(void) {
+    return buddy_root;
+}
+
+long mm_offset(void *ptr) {
+    return (ptr == NULL) ? 0 : (char *)ptr - mem_heap_lo();
+}
+
+void *mm_pointer(long offset) {
+    return (offset == 0) ? NULL : mem_heap_lo() + offset;
+}
+
+void mm_set_fit_policy(MmFitPolicy policy) {
+    (void)policy;
+}
+
+void mm_set_size_cache(int on) {
+    (void)on;
+}
+
+void mm_set_tiny(int on) {
+    (void)on;
+}
+
+void mm_set_two_ended(size_t large_size) {
+    (void)large_size;
+}
+
+void mm_set_bitmap(int on) {
+    (void)on;
+}
+
+void mm_set_spans(size_t min_size) {
+    (void)min_size;
+}
+
+void mm_set_site_heaps(int count) {
+    (void)count;
+}
+
+MmHandle mm_halloc(size_t size) {
+    (void)size;
+    return 0;  // buddy blocks cannot move
+}
+
+void *mm_hderef(MmHandle h) {
+    (void)h;
+    return NULL;
+}
+
+void mm_hfree(MmHandle h) {
+    (void)h;
+}
+
+int mm_compact(size_t budget) {
+    (void)budget;
+    return 1;
+}
+
+long mm_allocated_bytes(void) {
+    return mm_buddy_allocated_bytes();
+}
+
+long mm_heapsize(void) {
+    return mem_heapsize();
+}
+
+int mm_contains(void *lo, void *hi) {
+    return mem_contains(lo, hi);
+}
+
+MmHeap *mm_heap_create(void) {
+    return NULL;
+}
+
+void *mm_heap_malloc(MmHeap *heap, size_t size) {
+    (void)heap;
+    (void)size;
+    return NULL;
+}
+
+void *mm_heap_realloc(MmHeap *heap, void *ptr, size_t size) {
+    (void)heap;
+    (void)ptr;
+    (void)size;
+    return NULL;
+}
+
+void mm_heap_free(MmHeap *heap, void *ptr) {
+    (void)heap;
+    (void)ptr;
+}
+
+void mm_heap_destroy(MmHeap *heap) {
+    (void)heap;
+}
+#endif /* MM_BACKEND_BUDDY */
@@ -0,0 +1,17 @@
+#ifndef __MM_BUDDY_H__
+#define __MM_BUDDY_H__
+
+#include <stddef.h>  // size_t
+
+/**
+ * Binary buddy allocator on the memlib heap, with the same API as `mm.h`.
+ * Build with `make BACKEND=buddy` to serve the `mm_...` functions with it
+ * (this file is then built instead of `mm.c`).
+ */
+int   mm_buddy_init(void);
+void *mm_buddy_malloc(size_t size);
+void *mm_buddy_realloc(void *ptr, size_t size);
+void  mm_buddy_free(void *ptr);
+long  mm_buddy_allocated_bytes(void);
+
+#endif /* __MM_BUDDY_H__ */
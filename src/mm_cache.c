@@ -0,0 +1,82 @@
+#include <mm_cache.h>  // prototypes of functions implemented in this file
+#include <stddef.h>    // NULL
+
+/*
+ * Traces that request the same few sizes over and over free and reuse blocks
+ * of exactly those sizes, yet a fit search walks the free list (or the index)
+ * from the start each time. The cache is a direct-mapped array indexed by
+ * size / 8, up to `CACHE_MAX_SIZE`: each entry is a stack of the last free
+ * blocks of that size, so that an exact fit is found in O(1), and the most
+ * recently freed block (still in cache) is reused first.
+ *
+ * Cached blocks are still on the free list: the cache is only a shortcut to
+ * some of them. So every change to the free list goes through the cache too,
+ * including blocks merged away or resized by coalescing; a full stack simply
+ * leaves the extra blocks to the fit search.
+ */
+
+#define CACHE_MAX_SIZE 1024  // largest cached block size (a multiple of 8)
+#define CACHE_DEPTH 8        // blocks cached per size
+
+static BlockHeader *cache_blocks[CACHE_MAX_SIZE / 8 + 1][CACHE_DEPTH];
+static int cache_len[CACHE_MAX_SIZE / 8 + 1];
+
+/**
+ * Initializes to an empty cache.
+ */
+void mm_cache_init(void) {
+    for (int i = 0; i <= CACHE_MAX_SIZE / 8; i++)
+        cache_len[i] = 0;
+}
+
+/**
+ * Cache a free block, if its size is cached and its stack is not full.
+ *
+ * @param bp address of a free block header (with its size already written)
+ */
+void mm_cache_add(BlockHeader *bp) {
+    int size = mm_block_size(bp);
+    if (size > CACHE_MAX_SIZE)
+        return;
+    int c = size / 8;
+    if (cache_len[c] < CACHE_DEPTH)
+        cache_blocks[c][cache_len[c]++] = bp;
+}
+
+/**
+ * Drop a block from the cache (if cached) before it leaves the free list or
+ * changes size.
+ *
+ * @param bp address of a block header
+ * @param size size of the block when it was added
+ */
+void mm_cache_remove(BlockHeader *bp, int size) {
+    if (size > CACHE_MAX_SIZE)
+        return;
+    int c = size / 8;
+    BlockHeader **stack = cache_blocks[c];
+    for (int i = cache_len[c] - 1; i >= 0; i--) {
+        if (stack[i] == bp) {
+            // keep the order of the others, most recent on top
+            for (int j = i + 1; j < cache_len[c]; j++)
+                stack[j - 1] = stack[j];
+            cache_len[c]--;
+            return;
+        }
+    }
+}
+
+/**
+ * Find a cached free block of exactly `size` bytes (it stays cached until it
+ * is removed from the free list).
+ *
+ * @param size block size (a multiple of 8)
+ * @return pointer to the header of the most recently cached block of that
+ *         size, or `NULL` if none
+ */
+BlockHeader *mm_cache_find(int size) {
+    if (size > CACHE_MAX_SIZE)
+        return NULL;
+    int c = size / 8;
+    return (cache_len[c] > 0) ? cache_blocks[c][cache_len[c] - 1] : NULL;
+}
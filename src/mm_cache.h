@@ -0,0 +1,15 @@
+#ifndef __MM_CACHE_H__
+#define __MM_CACHE_H__
+
+#include <mm_block.h>  // BlockHeader
+
+/**
+ * Exact-size cache of free blocks: for each small block size, a short stack of
+ * free blocks of exactly that size, checked before any fit search.
+ */
+void mm_cache_init(void);
+void mm_cache_add(BlockHeader *bp);
+void mm_cache_remove(BlockHeader *bp, int size);
+BlockHeader *mm_cache_find(int size);
+
+#endif /* __MM_CACHE_H__ */
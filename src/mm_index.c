@@ -0,0 +1,243 @@
+#include <mm_index.h>  // prototypes of functions implemented in this file
+#include <stddef.h>    // NULL
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>  // SSE2/AVX2 intrinsics
+#define MM_INDEX_X86
+#endif
+
+/*
+ * Following `next_free` links costs one cache miss per free block, since free
+ * blocks are spread over the heap. The index keeps a copy of the size and the
+ * offset of each free block in two packed arrays, so that a fit search is a
+ * linear scan over contiguous memory: 4 (SSE2) or 8 (AVX2) sizes per compare.
+ *
+ * Entries are unordered: a removed entry is replaced by the last one. Slots
+ * past the last entry always hold sentinels (size 0, offset -1), so that scans
+ * can read whole vectors past the end without matching anything.
+ */
+
+#define INDEX_CAPACITY (1 << 16)
+#define INDEX_PAD 8  // one AVX2 vector of ints
+
+static int index_sizes[INDEX_CAPACITY + INDEX_PAD] __attribute__((aligned(32)));
+static int index_offsets[INDEX_CAPACITY + INDEX_PAD] __attribute__((aligned(32)));
+static int index_len;
+
+/**
+ * Slot of the last block found or added: `place` removes or resizes the block
+ * just returned by `mm_index_find`, so this avoids most scans for offsets.
+ */
+static int index_hint;
+
+/**
+ * Set when a block could not be added (index full): the index is then stale
+ * until the next `mm_index_init`, and searches must use the free list.
+ */
+static int index_overflow;
+
+/**
+ * Scan `values[0..len)` for the first value matching `key`.
+ *
+ * @return the index of the first match, or -1 if none
+ */
+typedef int (*scan_f)(const int *values, int len, int key);
+
+static scan_f scan_ge;  // first value >= key
+static scan_f scan_eq;  // first value == key
+
+static int scan_ge_scalar(const int *values, int len, int key) {
+    for (int i = 0; i < len; i++) {
+        if (values[i] >= key)
+            return i;
+    }
+    return -1;
+}
+
+static int scan_eq_scalar(const int *values, int len, int key) {
+    for (int i = 0; i < len; i++) {
+        if (values[i] == key)
+            return i;
+    }
+    return -1;
+}
+
+#ifdef MM_INDEX_X86
+
+__attribute__((target("sse2")))
+static int scan_ge_sse2(const int *values, int len, int key) {
+    __m128i k = _mm_set1_epi32(key - 1);
+    for (int i = 0; i < len; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+
+__attribute__((target("sse2")))
+static int scan_eq_sse2(const int *values, int len, int key) {
+    __m128i k = _mm_set1_epi32(key);
+    for (int i = 0; i < len; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, k)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+static int scan_ge_avx2(const int *values, int len, int key) {
+    __m256i k = _mm256_set1_epi32(key - 1);
+    for (int i = 0; i < len; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, k)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+
+__attribute__((target("avx2")))
+static int scan_eq_avx2(const int *values, int len, int key) {
+    __m256i k = _mm256_set1_epi32(key);
+    for (int i = 0; i < len; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, k)));
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+    return -1;
+}
+
+#endif /* MM_INDEX_X86 */
+
+/**
+ * Pick the widest scan functions supported by this CPU.
+ */
+static void index_dispatch(void) {
+    scan_ge = scan_ge_scalar;
+    scan_eq = scan_eq_scalar;
+#ifdef MM_INDEX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_ge = scan_ge_avx2;
+        scan_eq = scan_eq_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_ge = scan_ge_sse2;
+        scan_eq = scan_eq_sse2;
+    }
+#endif
+}
+
+static int index_offset(BlockHeader *bp) {
+    return (char *)bp - (char *)heap_blocks;
+}
+
+/**
+ * Find the slot of a block in the index.
+ *
+ * @param bp address of a free block header
+ * @return slot of the block, or -1 if not indexed
+ */
+static int index_slot(BlockHeader *bp) {
+    int off = index_offset(bp);
+    if (index_hint < index_len && index_offsets[index_hint] == off)
+        return index_hint;
+    int i = scan_eq(index_offsets, index_len, off);
+    return (i < index_len) ? i : -1;
+}
+
+/**
+ * Initializes to an empty index (call after setting `heap_blocks`).
+ */
+void mm_index_init(void) {
+    if (scan_ge == NULL)
+        index_dispatch();
+
+    for (int i = 0; i < index_len; i++) {
+        index_sizes[i] = 0;
+        index_offsets[i] = -1;
+    }
+    for (int i = index_len; i < INDEX_CAPACITY + INDEX_PAD; i++)
+        index_offsets[i] = -1;
+    index_len = 0;
+    index_hint = 0;
+    index_overflow = 0;
+}
+
+/**
+ * Check whether the index describes all free blocks.
+ *
+ * @return 1 if searches can use the index, 0 if they must use the free list
+ */
+int mm_index_valid(void) {
+    return !index_overflow;
+}
+
+/**
+ * Add a free block to the index.
+ *
+ * @param bp address of a free block header (with its size already written)
+ */
+void mm_index_add(BlockHeader *bp) {
+    if (index_overflow)
+        return;
+    if (index_len == INDEX_CAPACITY) {
+        index_overflow = 1;
+        return;
+    }
+    index_sizes[index_len] = mm_block_size(bp);
+    index_offsets[index_len] = index_offset(bp);
+    index_hint = index_len++;
+}
+
+/**
+ * Remove a free block from the index.
+ *
+ * @param bp address of a free block header
+ */
+void mm_index_remove(BlockHeader *bp) {
+    if (index_overflow)
+        return;
+    int i = index_slot(bp);
+    if (i < 0)
+        return;
+
+    // move the last entry into the hole, then put sentinels in its slot
+    index_len--;
+    index_sizes[i] = index_sizes[index_len];
+    index_offsets[i] = index_offsets[index_len];
+    index_sizes[index_len] = 0;
+    index_offsets[index_len] = -1;
+}
+
+/**
+ * Update the size of an indexed block after coalescing or splitting.
+ *
+ * @param bp address of a free block header (with its new size)
+ */
+void mm_index_resize(BlockHeader *bp) {
+    if (index_overflow)
+        return;
+    int i = index_slot(bp);
+    if (i >= 0)
+        index_sizes[i] = mm_block_size(bp);
+}
+
+/**
+ * Find a free block with size greater or equal to `size`.
+ *
+ * @param size minimum size of the free block
+ * @return pointer to the header of a free block or `NULL` if none is large
+ *         enough
+ */
+BlockHeader *mm_index_find(int size) {
+    int i = scan_ge(index_sizes, index_len, size);
+    if (i < 0 || i >= index_len)
+        return NULL;
+    index_hint = i;
+    return (BlockHeader *)((char *)heap_blocks + index_offsets[i]);
+}
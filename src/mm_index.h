@@ -0,0 +1,17 @@
+#ifndef __MM_INDEX_H__
+#define __MM_INDEX_H__
+
+#include <mm_block.h>  // BlockHeader
+
+/**
+ * Packed index of the free blocks: their sizes and offsets (from `heap_blocks`)
+ * in two contiguous arrays, searched with SIMD compares.
+ */
+void mm_index_init(void);
+int  mm_index_valid(void);
+void mm_index_add(BlockHeader *bp);
+void mm_index_remove(BlockHeader *bp);
+void mm_index_resize(BlockHeader *bp);
+BlockHeader *mm_index_find(int size);
+
+#endif /* __MM_INDEX_H__ */
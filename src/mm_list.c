@@ -14,17 +14,33 @@ void mm_list_init() {
 
 /**
  * In addition to the block header with size/allocated bit, a free block has
- * pointers to the headers of the previous and next blocks on the free list.
+ * links to the headers of the previous and next blocks on the free list.
  *
- * Pointers use 4 bytes because this project is compiled with -m32.
+ * Links are 4-byte offsets from `heap_blocks` (not pointers), so that the heap
+ * does not depend on the address where it is mapped, and free blocks fit in 16
+ * bytes also on 64-bit builds. Offset 0 (the prologue, never free) is `NULL`.
  * Check Figure 9.48(b) in the textbook.
  */
 typedef struct {
     BlockHeader header;
-    BlockHeader *prev_free;
-    BlockHeader *next_free;
+    int prev_free;
+    int next_free;
 } FreeBlockHeader;
 
+/**
+ * Convert a block address to a link (offset from `heap_blocks`).
+ */
+static int mm_list_link(BlockHeader *bp) {
+    return (bp == NULL) ? 0 : (char *)bp - (char *)heap_blocks;
+}
+
+/**
+ * Convert a link (offset from `heap_blocks`) to a block address.
+ */
+static BlockHeader *mm_list_block(int link) {
+    return (link == 0) ? NULL : (BlockHeader *)((char *)heap_blocks + link);
+}
+
 /**
  * Find the header address of the previous **free** block on the **free list**.
  *
@@ -33,7 +49,7 @@ typedef struct {
  */
 BlockHeader *mm_list_prev(BlockHeader *bp) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    return fp->prev_free;
+    return mm_list_block(fp->prev_free);
 }
 
 /**
@@ -44,7 +60,7 @@ BlockHeader *mm_list_prev(BlockHeader *bp) {
  */
 BlockHeader *mm_list_next(BlockHeader *bp) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    return fp->next_free;
+    return mm_list_block(fp->next_free);
 }
 
 /**
@@ -55,7 +71,7 @@ BlockHeader *mm_list_next(BlockHeader *bp) {
  */
 static void mm_list_prev_set(BlockHeader *bp, BlockHeader *prev) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    fp->prev_free = prev;
+    fp->prev_free = mm_list_link(prev);
 }
 
 
@@ -67,7 +83,7 @@ static void mm_list_prev_set(BlockHeader *bp, BlockHeader *prev) {
  */
 static void mm_list_next_set(BlockHeader *bp, BlockHeader *next) {
     FreeBlockHeader *fp = (FreeBlockHeader *)bp;
-    fp->next_free = next;
+    fp->next_free = mm_list_link(next);
 }
 
 /**
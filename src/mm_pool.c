@@ -0,0 +1,222 @@
+#include "mm_pool.h"  // prototypes of functions implemented in this file
+#include "mm.h"       // mm_malloc_aligned, mm_free -- chunks come from the mm heap
+#include <stdint.h>   // uintptr_t
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+/*
+ * A pool serves objects of a single size from chunks taken from the mm heap.
+ * Each chunk is a block whose payload is aligned to `chunk_bytes` (a power of
+ * 2), with a `PoolChunk` header, then the objects: the chunk of an object is
+ * found by masking its address, so that a free is O(1) whatever the number of
+ * chunks. The payload is 8 bytes short of `chunk_bytes`, so that with its
+ * header and footer the block takes exactly `chunk_bytes` and chunks allocated
+ * in a row tile the heap.
+ *
+ * Free objects are kept on an intrusive list in their chunk (the first word of
+ * each free object links to the next one), so objects carry no header, and
+ * the chunks with free objects are on a list of their own: `mm_pool_alloc`
+ * pops an object from the first of them, and `mm_pool_free` pushes it back on
+ * its chunk. No size lookup, no coalescing.
+ *
+ * Each chunk counts its free objects, so the pool knows when one becomes
+ * empty: like a magazine, it keeps one empty chunk for the next allocations
+ * and gives the others back to the mm heap at once, so a pool does not keep
+ * its peak memory after objects are freed.
+ */
+
+#define POOL_CHUNK_BYTES 4096  // smallest chunk block (at least one object)
+
+typedef struct PoolChunk {
+    struct PoolChunk *prev;          // all chunks of the pool
+    struct PoolChunk *next;
+    struct PoolChunk *partial_prev;  // chunks with free objects
+    struct PoolChunk *partial_next;
+    void *free_list;                 // first free object, or NULL
+    int free_count;                  // objects on `free_list`
+} PoolChunk;
+
+struct MmPool {
+    PoolChunk *chunks;
+    PoolChunk *partial;  // chunks with free objects
+    size_t object_size;  // a multiple of `align`
+    size_t align;
+    size_t chunk_bytes;  // block of a chunk, and alignment of its payload
+    size_t header;       // offset of the first object in a chunk
+    int per_chunk;       // objects per chunk
+    int empty;           // chunks with all their objects free
+};
+
+/**
+ * Create an empty pool.
+ *
+ * @param object_size bytes per object
+ * @param align alignment of objects (a power of 2; raised to the size of a
+ *        pointer, which free objects hold)
+ * @return the pool, or `NULL` if out of memory or `align` is not a power of 2
+ */
+MmPool *mm_pool_create(size_t object_size, size_t align) {
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    MmPool *pool = mm_malloc(sizeof(MmPool));
+    if (pool == NULL)
+        return NULL;
+
+    align = MAX(align, sizeof(void *));
+    object_size = MAX(object_size, 1);
+    pool->chunks = NULL;
+    pool->partial = NULL;
+    pool->align = align;
+    pool->object_size = (object_size + align - 1) & ~(align - 1);
+    pool->header = (sizeof(PoolChunk) + align - 1) & ~(align - 1);
+    pool->chunk_bytes = POOL_CHUNK_BYTES;
+    while (pool->chunk_bytes - 8 < pool->header + pool->object_size)
+        pool->chunk_bytes *= 2;
+    pool->per_chunk = (pool->chunk_bytes - 8 - pool->header) / pool->object_size;
+    pool->empty = 0;
+    return pool;
+}
+
+static void partial_add(MmPool *pool, PoolChunk *chunk) {
+    chunk->partial_prev = NULL;
+    chunk->partial_next = pool->partial;
+    if (pool->partial != NULL)
+        pool->partial->partial_prev = chunk;
+    pool->partial = chunk;
+}
+
+static void partial_remove(MmPool *pool, PoolChunk *chunk) {
+    if (chunk->partial_prev != NULL)
+        chunk->partial_prev->partial_next = chunk->partial_next;
+    else
+        pool->partial = chunk->partial_next;
+    if (chunk->partial_next != NULL)
+        chunk->partial_next->partial_prev = chunk->partial_prev;
+}
+
+/**
+ * Take a new chunk from the mm heap, with all its objects free.
+ *
+ * @param pool pool to grow
+ * @return 0 on success, -1 if out of memory
+ */
+static int pool_grow(MmPool *pool) {
+    PoolChunk *chunk = mm_malloc_aligned(pool->chunk_bytes - 8, pool->chunk_bytes);
+    if (chunk == NULL)
+        return -1;
+
+    chunk->prev = NULL;
+    chunk->next = pool->chunks;
+    if (pool->chunks != NULL)
+        pool->chunks->prev = chunk;
+    pool->chunks = chunk;
+
+    // push in reverse, so that objects are handed out in address order
+    chunk->free_list = NULL;
+    for (int i = pool->per_chunk - 1; i >= 0; i--) {
+        void **obj = (void **)((char *)chunk + pool->header + i * pool->object_size);
+        *obj = chunk->free_list;
+        chunk->free_list = obj;
+    }
+    chunk->free_count = pool->per_chunk;
+    partial_add(pool, chunk);
+    pool->empty++;
+    return 0;
+}
+
+/**
+ * Give an empty chunk back to the mm heap.
+ *
+ * @param pool pool of the chunk
+ * @param chunk chunk with all its objects free
+ */
+static void pool_release(MmPool *pool, PoolChunk *chunk) {
+    partial_remove(pool, chunk);
+    if (chunk->prev != NULL)
+        chunk->prev->next = chunk->next;
+    else
+        pool->chunks = chunk->next;
+    if (chunk->next != NULL)
+        chunk->next->prev = chunk->prev;
+    pool->empty--;
+    mm_free(chunk);
+}
+
+/**
+ * Allocate an object.
+ *
+ * @param pool pool to allocate from
+ * @return the object, or `NULL` if out of memory
+ */
+void *mm_pool_alloc(MmPool *pool) {
+    PoolChunk *chunk = pool->partial;
+    if (chunk == NULL) {
+        if (pool_grow(pool) < 0)
+            return NULL;
+        chunk = pool->partial;
+    }
+    if (chunk->free_count-- == pool->per_chunk)
+        pool->empty--;
+    if (chunk->free_count == 0)
+        partial_remove(pool, chunk);
+    void **obj = chunk->free_list;
+    chunk->free_list = *obj;
+    return obj;
+}
+
+/**
+ * Free an object. A chunk left with no object allocated goes back to the mm
+ * heap, unless it is the only empty one.
+ *
+ * @param pool pool the object was allocated from
+ * @param ptr the object, or `NULL`
+ */
+void mm_pool_free(MmPool *pool, void *ptr) {
+    if (ptr == NULL)
+        return;
+    PoolChunk *chunk = (PoolChunk *)((uintptr_t)ptr & ~(uintptr_t)(pool->chunk_bytes - 1));
+    if (chunk->free_count++ == 0)
+        partial_add(pool, chunk);
+    *(void **)ptr = chunk->free_list;
+    chunk->free_list = ptr;
+    if (chunk->free_count == pool->per_chunk && pool->empty++ > 0)
+        pool_release(pool, chunk);
+}
+
+/**
+ * Give back to the mm heap the chunks whose objects are all free (including
+ * the one kept by `mm_pool_free`).
+ *
+ * @param pool pool to trim
+ * @return number of chunks freed
+ */
+int mm_pool_trim(MmPool *pool) {
+    int freed = 0;
+    PoolChunk *chunk = pool->partial;
+    while (chunk != NULL) {
+        PoolChunk *next = chunk->partial_next;
+        if (chunk->free_count == pool->per_chunk) {
+            pool_release(pool, chunk);
+            freed++;
+        }
+        chunk = next;
+    }
+    return freed;
+}
+
+/**
+ * Free all objects of the pool and the pool itself.
+ *
+ * @param pool pool to destroy, or `NULL`
+ */
+void mm_pool_destroy(MmPool *pool) {
+    if (pool == NULL)
+        return;
+    PoolChunk *chunk = pool->chunks;
+    while (chunk != NULL) {
+        PoolChunk *next = chunk->next;
+        mm_free(chunk);
+        chunk = next;
+    }
+    mm_free(pool);
+}
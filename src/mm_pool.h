@@ -0,0 +1,17 @@
+#ifndef __MM_POOL_H__
+#define __MM_POOL_H__
+
+#include <stddef.h>  // size_t
+
+/**
+ * Pool of objects of one size, in chunks taken from the mm heap.
+ */
+typedef struct MmPool MmPool;
+
+MmPool *mm_pool_create(size_t object_size, size_t align);
+void   *mm_pool_alloc(MmPool *pool);
+void    mm_pool_free(MmPool *pool, void *ptr);
+int     mm_pool_trim(MmPool *pool);
+void    mm_pool_destroy(MmPool *pool);
+
+#endif /* __MM_POOL_H__ */
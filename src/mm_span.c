@@ -0,0 +1,413 @@
+#include <mm_span.h>  // prototypes of functions implemented in this file
+#include <memlib.h>   // mem_sbrk_top, mem_trim_top -- pages come from the top of the range
+#include <limits.h>   // INT_MAX
+#include <stdint.h>   // uintptr_t
+#include <stdlib.h>   // calloc, free -- map leaves and span descriptors
+
+/*
+ * A block of several pages costs as much to place as a 24-byte one: a walk of
+ * the free list, past the small free blocks, then boundary tags at both ends.
+ * The page heap serves such requests with spans: runs of whole pages, with a
+ * page-aligned payload and no header.
+ *
+ * The pages come from the top of the memlib range (`mem_sbrk_top`), so the
+ * page heap grows down from `span_hi` to `span_lo` while the default heap
+ * grows up. What is known of a span is in its descriptor, out of band: first
+ * page, number of pages, and whether it is free.
+ *
+ * A two-level radix tree maps a page (its index from `span_base`) to the
+ * descriptor of its span: the root holds 2048 leaves of 512 entries, each
+ * allocated when the page heap first grows into its 2 MB. Only the first and
+ * the last page of each span are kept up to date, which is all that lookups
+ * need: a payload is the first page of its span, and a free finds its
+ * neighbors from the page just before its span and the page just after it.
+ *
+ * Free spans are always coalesced with their free neighbors, and kept on the
+ * list of their length: one list per length of 1 to 127 pages, and list 0 for
+ * longer spans. An allocation takes the head of the first non-empty list from
+ * its length up (the rest of the span goes back to the list of its length),
+ * else the best fit among the long spans, else grows the page heap. So
+ * allocating and freeing spans of up to 127 pages take a bounded number of
+ * steps, whatever the number of blocks.
+ */
+
+#define SPAN_LEAF_BITS 9   // 512 pages (2 MB) per leaf
+#define SPAN_ROOT_BITS 11  // 2048 leaves (4 GB of pages)
+#define SPAN_LEAF_SIZE (1 << SPAN_LEAF_BITS)
+#define SPAN_ROOT_SIZE (1 << SPAN_ROOT_BITS)
+#define SPAN_LISTS 128     // spans of 1 to 127 pages by length, longer ones on list 0
+#define SPAN_BATCH 64      // descriptors allocated at a time
+
+typedef struct Span {
+    struct Span *prev;  // list of free spans of the same length
+    struct Span *next;  // (or of unused descriptors)
+    long first;         // index of the first page
+    long pages;         // number of pages
+    int free;
+} Span;
+
+typedef struct SpanBatch {
+    struct SpanBatch *next;
+    Span spans[SPAN_BATCH];
+} SpanBatch;
+
+static char *span_base;                   // page 0 (page-aligned)
+static char *span_lo;                     // lowest page of the page heap
+static char *span_hi;                     // end of the page heap
+static Span **span_root[SPAN_ROOT_SIZE];  // leaves of the map, `NULL` until used
+static Span span_lists[SPAN_LISTS];       // heads of the circular lists of free spans
+static Span *span_unused;                 // descriptors not in use
+static SpanBatch *span_batches;           // all descriptors, to free them on init
+static long span_allocated_pages;
+
+static char *page_addr(long page) {
+    return span_base + (page << SPAN_PAGE_SHIFT);
+}
+
+static long page_of(void *ptr) {
+    return ((char *)ptr - span_base) >> SPAN_PAGE_SHIFT;
+}
+
+/**
+ * Initializes to an empty page heap, starting at the first page boundary
+ * below the top break.
+ *
+ * @param base lowest address of the memlib range
+ * @return 0 on success, -1 if memlib has no top part (file-backed heap) or
+ *         its range is larger than the map
+ */
+int mm_span_init(char *base) {
+    for (int i = 0; i < SPAN_ROOT_SIZE; i++) {
+        free(span_root[i]);
+        span_root[i] = NULL;
+    }
+    while (span_batches != NULL) {
+        SpanBatch *next = span_batches->next;
+        free(span_batches);
+        span_batches = next;
+    }
+    span_unused = NULL;
+    for (int i = 0; i < SPAN_LISTS; i++) {
+        span_lists[i].prev = &span_lists[i];
+        span_lists[i].next = &span_lists[i];
+    }
+    span_allocated_pages = 0;
+    span_lo = NULL;
+    span_hi = NULL;
+    span_base = base - (uintptr_t)base % SPAN_PAGE;
+
+    char *top = mem_sbrk_top(0);
+    if ((long)top == -1)
+        return -1;
+    int pad = (uintptr_t)top % SPAN_PAGE;
+    if ((long)mem_sbrk_top(pad) == -1 || page_of(top) > (long)SPAN_ROOT_SIZE * SPAN_LEAF_SIZE)
+        return -1;
+    span_lo = top - pad;
+    span_hi = span_lo;
+    return 0;
+}
+
+static Span *map_get(long page) {
+    return span_root[page >> SPAN_LEAF_BITS][page & (SPAN_LEAF_SIZE - 1)];
+}
+
+static void map_set(long page, Span *span) {
+    span_root[page >> SPAN_LEAF_BITS][page & (SPAN_LEAF_SIZE - 1)] = span;
+}
+
+/**
+ * Allocate the leaves of the map for a range of pages.
+ *
+ * @param first index of the first page
+ * @param last index of the last page
+ * @return 0 on success, -1 if out of memory
+ */
+static int map_cover(long first, long last) {
+    for (long leaf = first >> SPAN_LEAF_BITS; leaf <= last >> SPAN_LEAF_BITS; leaf++) {
+        if (span_root[leaf] == NULL) {
+            span_root[leaf] = calloc(SPAN_LEAF_SIZE, sizeof(Span *));
+            if (span_root[leaf] == NULL)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Map the first and the last page of a span to its descriptor.
+ *
+ * @param span span whose pages changed
+ */
+static void span_record(Span *span) {
+    map_set(span->first, span);
+    map_set(span->first + span->pages - 1, span);
+}
+
+/**
+ * Take an unused descriptor (allocated, until marked free).
+ *
+ * @param first index of the first page
+ * @param pages number of pages
+ * @return the descriptor, or `NULL` if out of memory
+ */
+static Span *span_new(long first, long pages) {
+    if (span_unused == NULL) {
+        SpanBatch *batch = calloc(1, sizeof(SpanBatch));
+        if (batch == NULL)
+            return NULL;
+        batch->next = span_batches;
+        span_batches = batch;
+        for (int i = 0; i < SPAN_BATCH; i++) {
+            batch->spans[i].next = span_unused;
+            span_unused = &batch->spans[i];
+        }
+    }
+    Span *span = span_unused;
+    span_unused = span->next;
+    span->first = first;
+    span->pages = pages;
+    span->free = 0;
+    return span;
+}
+
+static void span_delete(Span *span) {
+    span->next = span_unused;
+    span_unused = span;
+}
+
+static void list_add(Span *span) {
+    Span *head = &span_lists[span->pages < SPAN_LISTS ? span->pages : 0];
+    span->free = 1;
+    span->prev = head;
+    span->next = head->next;
+    head->next->prev = span;
+    head->next = span;
+}
+
+static void list_remove(Span *span) {
+    span->free = 0;
+    span->prev->next = span->next;
+    span->next->prev = span->prev;
+}
+
+/**
+ * Find a free span of at least `pages` pages: the most recently freed one of
+ * the smallest length that has any, or the best fit among long spans.
+ *
+ * @param pages number of pages (at least 1)
+ * @return the span, or `NULL` if none is large enough
+ */
+static Span *span_find(long pages) {
+    for (long n = pages; n < SPAN_LISTS; n++) {
+        if (span_lists[n].next != &span_lists[n])
+            return span_lists[n].next;
+    }
+    Span *head = &span_lists[0];
+    Span *best = NULL;
+    for (Span *span = head->next; span != head; span = span->next) {
+        if (span->pages >= pages && (best == NULL || span->pages < best->pages ||
+                                     (span->pages == best->pages && span->first < best->first)))
+            best = span;
+    }
+    return best;
+}
+
+/**
+ * Grow the page heap down, so that its lowest span is a free span of `pages`
+ * pages (only the missing pages are added if the lowest span is free).
+ *
+ * @param pages number of pages (at least 1)
+ * @return the lowest span (not on a list), or `NULL` if memlib is full
+ */
+static Span *span_grow(long pages) {
+    Span *low = (span_lo < span_hi) ? map_get(page_of(span_lo)) : NULL;
+    if (low != NULL && !low->free)
+        low = NULL;
+    long bytes = (pages - (low != NULL ? low->pages : 0)) << SPAN_PAGE_SHIFT;
+    if (bytes > INT_MAX)
+        return NULL;
+    char *lo = mem_sbrk_top(bytes);
+    if ((long)lo == -1)
+        return NULL;
+    if (lo != span_lo - bytes || map_cover(page_of(lo), page_of(span_lo) - 1) < 0) {
+        mem_trim_top(bytes);  // something else took the top part in between
+        return NULL;
+    }
+
+    if (low != NULL) {
+        list_remove(low);
+        low->first = page_of(lo);
+        low->pages = pages;
+    } else {
+        low = span_new(page_of(lo), pages);
+        if (low == NULL) {
+            mem_trim_top(bytes);
+            return NULL;
+        }
+    }
+    span_lo = lo;
+    span_record(low);
+    return low;
+}
+
+/**
+ * Merge a span with its free neighbors, and put the result on its list.
+ *
+ * @param span span whose pages are no longer used (not on a list)
+ */
+static void span_coalesce(Span *span) {
+    if (page_addr(span->first) > span_lo) {
+        Span *prev = map_get(span->first - 1);
+        if (prev->free) {
+            list_remove(prev);
+            prev->pages += span->pages;
+            span_delete(span);
+            span = prev;
+        }
+    }
+    long end = span->first + span->pages;
+    if (page_addr(end) < span_hi) {
+        Span *next = map_get(end);
+        if (next->free) {
+            list_remove(next);
+            span->pages += next->pages;
+            span_delete(next);
+        }
+    }
+    span_record(span);
+    list_add(span);
+}
+
+/**
+ * Allocate a span.
+ *
+ * @param size payload size in bytes (rounded up to whole pages)
+ * @return the payload address (page-aligned), or `NULL` if `size` is 0 or
+ *         memlib is full
+ */
+void *mm_span_alloc(size_t size) {
+    if (size == 0 || size > (size_t)(span_hi - span_base))
+        return NULL;
+    long pages = (size + SPAN_PAGE - 1) >> SPAN_PAGE_SHIFT;
+    Span *span = span_find(pages);
+    if (span != NULL)
+        list_remove(span);
+    else if ((span = span_grow(pages)) == NULL)
+        return NULL;
+
+    // the pages after the payload stay free (if a descriptor is available)
+    if (span->pages > pages) {
+        Span *rest = span_new(span->first + pages, span->pages - pages);
+        if (rest != NULL) {
+            span->pages = pages;
+            span_record(rest);
+            list_add(rest);
+        }
+    }
+    span_record(span);
+    span_allocated_pages += span->pages;
+    return page_addr(span->first);
+}
+
+/**
+ * Free a span.
+ *
+ * @param ptr payload of an allocated span
+ */
+void mm_span_free(void *ptr) {
+    Span *span = map_get(page_of(ptr));
+    span_allocated_pages -= span->pages;
+    span_coalesce(span);
+}
+
+/**
+ * Check whether an address is in the page heap.
+ *
+ * @param ptr any address
+ * @return 1 if `ptr` is in the pages of a span, 0 otherwise
+ */
+int mm_span_owns(void *ptr) {
+    return (char *)ptr >= span_lo && (char *)ptr < span_hi;
+}
+
+/**
+ * Usable size of a span.
+ *
+ * @param ptr payload of an allocated span
+ * @return bytes of its pages
+ */
+size_t mm_span_size(void *ptr) {
+    return (size_t)map_get(page_of(ptr))->pages << SPAN_PAGE_SHIFT;
+}
+
+/**
+ * Resize a span in place: pages after the new end are freed, and missing
+ * pages are taken from the front of the next span if it is free.
+ *
+ * @param ptr payload of an allocated span
+ * @param size new payload size in bytes (not 0)
+ * @return 0 on success, -1 if the span cannot grow in place
+ */
+int mm_span_resize(void *ptr, size_t size) {
+    Span *span = map_get(page_of(ptr));
+    if (size > (size_t)(span_hi - (char *)ptr))
+        return -1;
+    long pages = (size + SPAN_PAGE - 1) >> SPAN_PAGE_SHIFT;
+    long extra = pages - span->pages;
+    if (extra < 0) {
+        Span *rest = span_new(span->first + pages, -extra);
+        if (rest != NULL) {
+            span->pages = pages;
+            span_allocated_pages += extra;
+            span_record(span);
+            span_coalesce(rest);
+        }
+    } else if (extra > 0) {
+        long end = span->first + span->pages;
+        Span *next = (page_addr(end) < span_hi) ? map_get(end) : NULL;
+        if (next == NULL || !next->free || next->pages < extra)
+            return -1;
+        list_remove(next);
+        if (next->pages > extra) {
+            next->first += extra;
+            next->pages -= extra;
+            span_record(next);
+            list_add(next);
+        } else {
+            span_delete(next);
+        }
+        span->pages = pages;
+        span_allocated_pages += extra;
+        span_record(span);
+    }
+    return 0;
+}
+
+/**
+ * Give back the lowest span to memlib if it is free, so that the heap below
+ * can grow into its pages.
+ *
+ * @return bytes given back (0 if the lowest span is allocated)
+ */
+long mm_span_release(void) {
+    if (span_lo == span_hi)
+        return 0;
+    Span *low = map_get(page_of(span_lo));
+    if (!low->free)
+        return 0;
+    long bytes = low->pages << SPAN_PAGE_SHIFT;
+    list_remove(low);
+    span_delete(low);
+    mem_trim_top(bytes);
+    span_lo += bytes;
+    return bytes;
+}
+
+/**
+ * Bytes in allocated spans (whole pages).
+ *
+ * @return number of bytes
+ */
+long mm_span_allocated_bytes(void) {
+    return span_allocated_pages << SPAN_PAGE_SHIFT;
+}
@@ -0,0 +1,22 @@
+#ifndef __MM_SPAN_H__
+#define __MM_SPAN_H__
+
+#include <stddef.h>  // size_t
+
+#define SPAN_PAGE_SHIFT 12
+#define SPAN_PAGE (1 << SPAN_PAGE_SHIFT)  // bytes of a page of the page heap
+
+/**
+ * Page heap: spans of whole pages at the top of the memlib range (growing
+ * down), with page-aligned payloads and no header.
+ */
+int    mm_span_init(char *base);
+void  *mm_span_alloc(size_t size);
+void   mm_span_free(void *ptr);
+int    mm_span_owns(void *ptr);
+size_t mm_span_size(void *ptr);
+int    mm_span_resize(void *ptr, size_t size);
+long   mm_span_release(void);
+long   mm_span_allocated_bytes(void);
+
+#endif /* __MM_SPAN_H__ */
@@ -0,0 +1,212 @@
+#include <mm_tiny.h>  // prototypes of functions implemented in this file
+#include <stddef.h>   // NULL
+#include <limits.h>   // INT_MAX
+#include <stdint.h>   // uintptr_t
+#include <stdlib.h>   // realloc, free -- the map
+#include <string.h>   // memset, memmove
+
+/*
+ * The smallest block of the heap is 16 bytes (header, two list links and a
+ * footer), so a request of 1 to 8 bytes costs at least twice its size. Tiny
+ * requests get 8-byte cells instead, with no header and no footer: a cell is
+ * found by its address alone.
+ *
+ * Cells are packed in containers, each the payload of a 4 KB block taken from
+ * the heap: a `TinyPage` header, then the cells. The free cells of a container
+ * are on a singly linked list (the first word of a free cell links to the next
+ * one), and the containers with free cells are on a doubly linked list, so
+ * that allocating and freeing a cell are O(1).
+ *
+ * To find the container of a cell, the memlib range of the heap is split into
+ * 4 KB pages, and `tiny_map` keeps, for each page, the offset of the container
+ * starting in it (at most one does, since a container is as large as a page).
+ * A cell is in the container starting in its page, or in the previous page.
+ * The map is sized for the range at `mm_tiny_init`, and grows when a container
+ * is taken outside it (in an extra region, below the range).
+ *
+ * One empty container is kept for the next tiny requests; the others go back
+ * to the heap as soon as they are empty.
+ */
+
+#define TINY_MAP_SHIFT 12  // 4 KB pages
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+typedef struct TinyPage {
+    struct TinyPage *prev;  // containers with free cells
+    struct TinyPage *next;
+    void *free_cells;       // first free cell, or NULL
+    int used;               // cells allocated
+    int cells;              // cells in the container
+} TinyPage;
+
+#define TINY_HEADER ((sizeof(TinyPage) + TINY_SIZE - 1) & ~(size_t)(TINY_SIZE - 1))
+
+static char *tiny_base;         // start of the mapped range
+static int *tiny_map;           // container offset from `tiny_base`, or 0
+static long tiny_pages;         // pages in the map
+static TinyPage *tiny_partial;  // containers with free cells
+static int tiny_empty;          // containers with no cell allocated
+
+/**
+ * Grow the map to the page of an address, moving `tiny_base` down if the
+ * address is below it.
+ *
+ * @param addr address to map
+ * @return 0 on success, -1 if out of memory or the range would not fit the
+ *         offsets
+ */
+static int tiny_cover(char *addr) {
+    long below = 0;  // pages added below `tiny_base`, which stays below `addr`
+    if (addr < tiny_base)                                  // (0 is no container)
+        below = ((tiny_base - addr) >> TINY_MAP_SHIFT) + 1;
+    char *base = tiny_base - (below << TINY_MAP_SHIFT);
+    long pages = MAX(tiny_pages + below, ((addr - base) >> TINY_MAP_SHIFT) + 1);
+    if (pages > (long)INT_MAX >> TINY_MAP_SHIFT)
+        return -1;
+    int *map = realloc(tiny_map, pages * sizeof(int));
+    if (map == NULL)
+        return -1;
+
+    memmove(map + below, map, tiny_pages * sizeof(int));
+    memset(map, 0, below * sizeof(int));
+    memset(map + below + tiny_pages, 0, (pages - below - tiny_pages) * sizeof(int));
+    for (long i = below; i < below + tiny_pages; i++) {
+        if (map[i] != 0)
+            map[i] += below << TINY_MAP_SHIFT;
+    }
+    tiny_base = base;
+    tiny_map = map;
+    tiny_pages = pages;
+    return 0;
+}
+
+/**
+ * Initializes to no container, with a map for a range of the heap.
+ *
+ * @param base lowest address of the heap (containers are above it)
+ * @param size bytes the heap can grow to from `base` (the memlib limit)
+ * @return 0 on success, -1 if out of memory
+ */
+int mm_tiny_init(char *base, long size) {
+    free(tiny_map);
+    tiny_map = NULL;
+    tiny_pages = 0;
+    tiny_base = base;
+    tiny_partial = NULL;
+    tiny_empty = 0;
+    return tiny_cover(base + MAX(size, 1) - 1);
+}
+
+static void partial_add(TinyPage *page) {
+    page->prev = NULL;
+    page->next = tiny_partial;
+    if (tiny_partial != NULL)
+        tiny_partial->prev = page;
+    tiny_partial = page;
+}
+
+static void partial_remove(TinyPage *page) {
+    if (page->prev != NULL)
+        page->prev->next = page->next;
+    else
+        tiny_partial = page->next;
+    if (page->next != NULL)
+        page->next->prev = page->prev;
+}
+
+/**
+ * Allocate a cell from a container with free cells.
+ *
+ * @return address of the cell, or `NULL` if all containers are full
+ */
+void *mm_tiny_alloc(void) {
+    TinyPage *page = tiny_partial;
+    if (page == NULL)
+        return NULL;
+    void **cell = page->free_cells;
+    page->free_cells = *cell;
+    if (page->used++ == 0)
+        tiny_empty--;
+    if (page->free_cells == NULL)
+        partial_remove(page);
+    return cell;
+}
+
+/**
+ * Turn a block payload into an empty container.
+ *
+ * @param page payload of an allocated block of at least `TINY_PAGE_BYTES`
+ *        (8-byte aligned)
+ * @return 0 on success, -1 if the map cannot grow to the payload (it is left
+ *         untouched)
+ */
+int mm_tiny_add_page(char *page) {
+    uintptr_t offset = (uintptr_t)page - (uintptr_t)tiny_base;  // wraps if below
+    if ((offset >> TINY_MAP_SHIFT) >= (uintptr_t)tiny_pages) {
+        if (tiny_cover(page) < 0)
+            return -1;
+        offset = page - tiny_base;
+    }
+    if (offset == 0)
+        return -1;
+    tiny_map[offset >> TINY_MAP_SHIFT] = offset;
+
+    TinyPage *tp = (TinyPage *)page;
+    tp->cells = (TINY_PAGE_BYTES - TINY_HEADER) / TINY_SIZE;
+    tp->used = 0;
+    tp->free_cells = NULL;
+    // push in reverse, so that cells are handed out in address order
+    for (int i = tp->cells - 1; i >= 0; i--) {
+        void **cell = (void **)(page + TINY_HEADER + i * TINY_SIZE);
+        *cell = tp->free_cells;
+        tp->free_cells = cell;
+    }
+    partial_add(tp);
+    tiny_empty++;
+    return 0;
+}
+
+/**
+ * Find the container of a cell.
+ *
+ * @param ptr any address
+ * @return payload of the container holding `ptr` as a cell, or `NULL` if
+ *         `ptr` is not a cell
+ */
+char *mm_tiny_page_of(void *ptr) {
+    uintptr_t offset = (uintptr_t)ptr - (uintptr_t)tiny_base;  // wraps if below
+    uintptr_t index = offset >> TINY_MAP_SHIFT;
+    if (index >= (uintptr_t)tiny_pages)
+        return NULL;
+    uintptr_t start = tiny_map[index];
+    if (start == 0 || start > offset)
+        start = (index > 0) ? tiny_map[index - 1] : 0;
+    if (start == 0 || offset < start + TINY_HEADER || offset >= start + TINY_PAGE_BYTES)
+        return NULL;
+    return tiny_base + start;
+}
+
+/**
+ * Free a cell.
+ *
+ * @param ptr address of an allocated cell
+ * @return payload of a container that became empty and is no longer used (to
+ *         give back to the heap), or `NULL`
+ */
+char *mm_tiny_free(void *ptr) {
+    char *payload = mm_tiny_page_of(ptr);
+    TinyPage *page = (TinyPage *)payload;
+    if (page->free_cells == NULL)
+        partial_add(page);
+    *(void **)ptr = page->free_cells;
+    page->free_cells = ptr;
+    if (--page->used > 0)
+        return NULL;
+
+    if (tiny_empty++ == 0)
+        return NULL;  // kept for the next tiny requests
+    tiny_empty--;
+    partial_remove(page);
+    tiny_map[((uintptr_t)payload - (uintptr_t)tiny_base) >> TINY_MAP_SHIFT] = 0;
+    return payload;
+}
@@ -0,0 +1,17 @@
+#ifndef __MM_TINY_H__
+#define __MM_TINY_H__
+
+#define TINY_SIZE 8            // payload bytes of a cell (largest tiny request)
+#define TINY_PAGE_BYTES 4088   // payload of a container: its block is a 4 KB page
+
+/**
+ * Tiny-object class: requests of up to 8 bytes are served from 8-byte cells,
+ * packed in page-sized containers (blocks of the mm heap), with no header.
+ */
+int   mm_tiny_init(char *base, long size);
+void *mm_tiny_alloc(void);
+int   mm_tiny_add_page(char *page);
+char *mm_tiny_page_of(void *ptr);
+char *mm_tiny_free(void *ptr);
+
+#endif /* __MM_TINY_H__ */
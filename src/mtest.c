@@ -2,15 +2,20 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "mm_buddy.h"
+#include "refalloc.h"
 
 #include <stdio.h>   // printf, fprintf, sprintf, stderr, EOF, FILE
+#include <stdint.h>  // uintptr_t
+#include <limits.h>  // INT_MAX
 #include <stdlib.h>  // exit, free, malloc, realloc, free, atoi
-#include <string.h>  // memset, strdup (needs _POSIX_C_SOURCE), strncmp
+#include <string.h>  // memset, strdup (needs _POSIX_C_SOURCE), strcmp, strtok
 #include <assert.h>  // assert
 #include <float.h>   // DBL_MAX
 #include <time.h>    // clock_gettime, CLOCK_MONOTONIC
 #include <getopt.h>  // getopt, optarg
 #include <math.h>    // fmin
+#include <sys/resource.h>  // getrusage -- to count page faults
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
@@ -47,10 +52,10 @@ typedef struct BlockItem {
     struct BlockItem *next;
 } BlockItem;
 
-static int add_block(BlockItem **blocks, char *lo, int size, int tracenum, int opnum) {
+static int add_block(BlockItem **blocks, char *lo, int size, int on_heap, int tracenum, int opnum) {
     char msg[1024];
 
-    if ((unsigned int)lo % 8 != 0) {
+    if ((uintptr_t)lo % 8 != 0) {
         sprintf(msg, "Payload address (%p) not aligned to 8 bytes", lo);
         trace_error(tracenum, opnum, msg);
         return 0;
@@ -58,9 +63,8 @@ static int add_block(BlockItem **blocks, char *lo, int size, int tracenum, int o
 
     assert(size > 0);
     char *hi = lo + size - 1;
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) ||
-        (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
-        sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)", lo, hi, mem_heap_lo(), mem_heap_hi());
+    if (on_heap && !mm_contains(lo, hi)) {
+        sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p) and its regions", lo, hi, mem_heap_lo(), mem_heap_hi());
         trace_error(tracenum, opnum, msg);
         return 0;
     }
@@ -113,6 +117,7 @@ typedef struct {
     enum {ALLOC, FREE, REALLOC} type;
     int index;
     int size;
+    int lifetime;  // ALLOC: ops until the block is freed (INT_MAX if never)
 } TraceOp;
 
 typedef struct {
@@ -130,6 +135,26 @@ static void free_trace(Trace *trace) {
     free(trace);
 }
 
+/* annotate each allocation with its exact lifetime, for the oracle replay (-o) */
+static void set_lifetimes(Trace *trace) {
+    int *alloc_op = malloc(trace->num_ids * sizeof(int));
+    if (alloc_op == NULL) {
+        perror("malloc failed in set_lifetimes");
+        exit(1);
+    }
+    for (int i = 0; i < trace->num_ops; i++) {
+        TraceOp *op = &trace->ops[i];
+        if (op->type == ALLOC) {
+            op->lifetime = INT_MAX;
+            alloc_op[op->index] = i;
+        } else if (op->type == FREE) {
+            int a = alloc_op[op->index];
+            trace->ops[a].lifetime = i - a;
+        }
+    }
+    free(alloc_op);
+}
+
 static Trace *read_trace(char *filename) {
     FILE *tracefile = fopen(filename, "r");
     if (tracefile == NULL) {
@@ -191,6 +216,7 @@ static Trace *read_trace(char *filename) {
     assert(max_block_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
     fclose(tracefile);
+    set_lifetimes(trace);
     return trace;
 }
 
@@ -198,8 +224,36 @@ static Trace *read_trace(char *filename) {
 typedef void *(*malloc_f)(size_t size);
 typedef void *(*realloc_f)(void *ptr, size_t size);
 typedef void  (*free_f)(void *ptr);
+typedef void *(*hint_f)(size_t size, int lifetime);
+
+typedef struct {
+    char     *name;
+    int     (*init)(void);       // prepare an empty allocator (NULL if none needed)
+    malloc_f  malloc_fn;
+    realloc_f realloc_fn;
+    free_f    free_fn;
+    void    (*reset)(void);      // discard all allocations (NULL if not possible)
+    long    (*heapsize)(void);   // bytes taken from memlib (NULL if not on memlib)
+    long    (*allocated)(void);  // bytes in allocated blocks (NULL if unknown)
+    hint_f    hint_fn;           // malloc told the lifetime of the block (NULL if none)
+    int       no_reuse;          // never reuses memory: reset before each timed replay
+} Allocator;
+
+/* allocate for an ALLOC op, passing its lifetime when replaying with the oracle */
+static void *op_malloc(malloc_f test_malloc, hint_f test_hint, TraceOp *op) {
+    if (test_hint != NULL)
+        return test_hint(op->size, op->lifetime);
+    return test_malloc(op->size);
+}
+
+static int eval_valid(Allocator *alloc, hint_f test_hint, Trace *trace, int tracenum,
+        double *internal_frag, long *peak_heapsize) {
 
-static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_free, Trace *trace, int tracenum) {
+    malloc_f test_malloc = alloc->malloc_fn;
+    realloc_f test_realloc = alloc->realloc_fn;
+    free_f test_free = alloc->free_fn;
+    int on_heap = alloc->heapsize != NULL;
+    long peak_allocated = 0;  // bytes in allocated blocks at the peak of total_size
 
     int max_total_size = 0;
     int total_size = 0;
@@ -210,19 +264,21 @@ static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_
         int size = trace->ops[i].size;
         switch (trace->ops[i].type) {
             case ALLOC: {
-                char *p = test_malloc(size);
+                char *p = op_malloc(test_malloc, test_hint, &trace->ops[i]);
                 if (p == NULL) {
                     trace_error(tracenum, i, "mm_malloc failed.");
                     return 0;
                 }
 
-                if (add_block(&blocks, p, size, tracenum, i) == 0)
+                if (add_block(&blocks, p, size, on_heap, tracenum, i) == 0)
                     return 0;
 
                 memset(p, index & 0xFF, size);  // for realloc checks
                 trace->blocks[index] = p;
                 trace->block_sizes[index] = size;
                 total_size += size;
+                if (total_size > max_total_size && alloc->allocated != NULL)
+                    peak_allocated = alloc->allocated();
                 max_total_size = MAX(total_size, max_total_size);
                 break;
             }
@@ -236,7 +292,7 @@ static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_
                 }
 
                 remove_block(&blocks, oldp);
-                if (add_block(&blocks, newp, size, tracenum, i) == 0)
+                if (add_block(&blocks, newp, size, on_heap, tracenum, i) == 0)
                     return 0;
 
                 int old_size = trace->block_sizes[index];
@@ -253,6 +309,8 @@ static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_
                 trace->block_sizes[index] = size;
 
                 total_size += size - old_size;
+                if (total_size > max_total_size && alloc->allocated != NULL)
+                    peak_allocated = alloc->allocated();
                 max_total_size = MAX(total_size, max_total_size);
                 break;
             }
@@ -269,21 +327,26 @@ static int eval_valid(malloc_f test_malloc, realloc_f test_realloc, free_f test_
                 printf("Nonexistent request type in eval_mm_valid\n");
                 exit(1);
         }
+
+        // a heap that gives memory back (like the short-lived mm heap) still cost its peak
+        if (on_heap)
+            *peak_heapsize = MAX(*peak_heapsize, alloc->heapsize());
     }
 
     free_blocks(&blocks);
+    if (peak_allocated > 0)
+        *internal_frag = 1.0 - (double)max_total_size / peak_allocated;
     return max_total_size;
 }
 
 static void replay_trace(malloc_f test_malloc, realloc_f test_realloc,
-        free_f test_free, Trace *trace) {
+        free_f test_free, hint_f test_hint, Trace *trace) {
 
     for (int i = 0;  i < trace->num_ops;  i++) {
         switch (trace->ops[i].type) {
             case ALLOC: {
                 int index = trace->ops[i].index;
-                int size = trace->ops[i].size;
-                char *p = test_malloc(size);
+                char *p = op_malloc(test_malloc, test_hint, &trace->ops[i]);
                 if (p == NULL) {
                     printf("mm_malloc error in eval_mm_speed\n");
                     exit(1);
@@ -319,29 +382,191 @@ static void replay_trace(malloc_f test_malloc, realloc_f test_realloc,
     }
 }
 
-static double eval_speed(malloc_f test_malloc, realloc_f test_realloc,
-        free_f test_free, Trace *trace, int repeat_min, int num_executions) {
+/* start an allocator from scratch before running a trace */
+static int alloc_reset(Allocator *alloc) {
+    if (alloc->reset != NULL)
+        alloc->reset();
+    if (alloc->init != NULL)
+        return alloc->init();
+    return 0;
+}
+
+/* time replays of a trace; an allocator that never reuses memory starts each
+   one on a fresh heap (not timed), since it would run out of heap otherwise */
+static double eval_speed(Allocator *alloc, hint_f test_hint, Trace *trace, int repeat_min,
+        int num_executions) {
     struct timespec t0;
     struct timespec t1;
     double min = DBL_MAX;
     for (int i = 0; i < repeat_min; i++) {
-        clock_gettime(CLOCK_MONOTONIC, &t0);
+        double elapsed = 0;
         for (int j = 0; j < num_executions; j++) {
-            replay_trace(test_malloc, test_realloc, test_free, trace);
+            if (alloc->no_reuse && alloc_reset(alloc) < 0) {
+                printf("%s init failed in eval_speed\n", alloc->name);
+                exit(1);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &t0);
+            replay_trace(alloc->malloc_fn, alloc->realloc_fn, alloc->free_fn, test_hint, trace);
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+            elapsed += (t1.tv_sec - t0.tv_sec)*1000.0 + (t1.tv_nsec - t0.tv_nsec)/1000000.0;
         }
-        clock_gettime(CLOCK_MONOTONIC, &t1);
-        double elapsed = (t1.tv_sec - t0.tv_sec)*1000.0 + (t1.tv_nsec - t0.tv_nsec)/1000000.0;
         min = fmin(min, elapsed/num_executions);
    }
    return min;
 }
 
+/* allocator registry */
+static int mm_first_fit_init(void) {
+    mm_set_fit_policy(MM_FIRST_FIT);
+    return mm_init();
+}
+
+static int mm_best_fit_init(void) {
+    mm_set_fit_policy(MM_BEST_FIT);
+    return mm_init();
+}
+
+static int mm_index_fit_init(void) {
+    mm_set_fit_policy(MM_INDEX_FIT);
+    return mm_init();
+}
+
+static int mm_size_cache_init(void) {
+    mm_set_fit_policy(MM_FIRST_FIT);
+    mm_set_size_cache(1);
+    int result = mm_init();
+    mm_set_size_cache(0);  // the other variants search the free list only
+    return result;
+}
+
+static int mm_tiny_mode_init(void) {
+    mm_set_fit_policy(MM_FIRST_FIT);
+    mm_set_tiny(1);
+    int result = mm_init();
+    mm_set_tiny(0);  // the other variants give 8-byte requests a block
+    return result;
+}
+
+#define TWO_ENDED_SIZE 2048  /* smallest block taken from the top in two-ended mode */
+
+static int mm_two_ended_init(void) {
+    mm_set_fit_policy(MM_FIRST_FIT);
+    mm_set_two_ended(TWO_ENDED_SIZE);
+    int result = mm_init();
+    mm_set_two_ended(0);  // the other variants grow from the bottom only
+    return result;
+}
+
+static int mm_bitmap_mode_init(void) {
+    mm_set_fit_policy(MM_FIRST_FIT);
+    mm_set_bitmap(1);
+    int result = mm_init();
+    mm_set_bitmap(0);  // the other variants keep footers
+    return result;
+}
+
+#define SPAN_SIZE (16 * 1024)  /* smallest block served by a span in span mode */
+
+static int mm_spans_init(void) {
+    mm_set_fit_policy(MM_FIRST_FIT);
+    mm_set_spans(SPAN_SIZE);
+    int result = mm_init();
+    mm_set_spans(0);  // the other variants have no page heap
+    return result;
+}
+
+/*
+ * Lifetime-segregating reference policy for the oracle replay (-o): blocks
+ * freed within ORACLE_SHORT ops go to the short-lived heap, blocks never freed
+ * are packed at the bottom (see `mm_malloc_hint`).
+ */
+#define ORACLE_SHORT 64
+
+static void *mm_oracle_malloc(size_t size, int lifetime) {
+    int hint = 0;
+    if (lifetime < ORACLE_SHORT)
+        hint = MM_SHORT_LIVED;
+    else if (lifetime == INT_MAX)
+        hint = MM_LONG_LIVED;
+    return mm_malloc_hint(size, hint);
+}
+
+static Allocator allocators[] = {
+    {"libc",      NULL,              malloc,    realloc,    free,    NULL,          NULL,
+        NULL, NULL, 0},
+    {"mm",        mm_first_fit_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"first-fit", mm_first_fit_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"best-fit",  mm_best_fit_init,  mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"indexed",   mm_index_fit_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"size-cache", mm_size_cache_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"tiny",      mm_tiny_mode_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"two-ended", mm_two_ended_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"bitmap",    mm_bitmap_mode_init, mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"spans",     mm_spans_init,     mm_malloc, mm_realloc, mm_free, mem_reset_brk, mm_heapsize,
+        mm_allocated_bytes, mm_oracle_malloc, 0},
+    {"buddy",     mm_buddy_init,     mm_buddy_malloc, mm_buddy_realloc, mm_buddy_free,
+        mem_reset_brk, mem_heapsize, mm_buddy_allocated_bytes, NULL, 0},
+    {"bump",      ref_bump_init,     ref_bump_malloc, ref_bump_realloc, ref_bump_free,
+        mem_reset_brk, mem_heapsize, NULL, NULL, 1},
+    {"implicit",  ref_implicit_init, ref_implicit_malloc, ref_implicit_realloc, ref_implicit_free,
+        mem_reset_brk, mem_heapsize, NULL, NULL, 0},
+};
+static int allocators_len = sizeof(allocators) / sizeof(allocators[0]);
+
+static Allocator *find_allocator(char *name) {
+    for (int i = 0; i < allocators_len; i++) {
+        if (strcmp(allocators[i].name, name) == 0)
+            return &allocators[i];
+    }
+    return NULL;
+}
+
+/* number of page faults of this process so far */
+static long page_faults(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+/* memlib configurations (-m) */
+typedef struct {
+    char *name;
+    MemConfig config;
+} MemMode;
+
+static MemMode mem_modes[] = {
+    {"lazy",     {MEM_BACKING_ANON,   0, 0, 0, NULL}},
+    {"prefault", {MEM_BACKING_ANON,   0, 1, 0, NULL}},
+    {"huge",     {MEM_BACKING_ANON,   0, 0, 1, NULL}},
+    {"malloc",   {MEM_BACKING_MALLOC, 0, 0, 0, NULL}},
+    {"memfd",    {MEM_BACKING_MEMFD,  0, 0, 0, NULL}},
+};
+static int mem_modes_len = sizeof(mem_modes) / sizeof(mem_modes[0]);
+
+static MemMode *find_mem_mode(char *name) {
+    for (int i = 0; i < mem_modes_len; i++) {
+        if (strcmp(mem_modes[i].name, name) == 0)
+            return &mem_modes[i];
+    }
+    return NULL;
+}
+
 /* output printing */
 typedef struct {
     int valid;
     double util;
+    double internal_frag;  // fraction of allocated bytes not requested, at peak
     double ops;
     double ms;
+    long faults;           // page faults while validating (on a fresh heap)
 } TraceStats;
 
 typedef struct {
@@ -351,34 +576,38 @@ typedef struct {
     double total_ops;
     double total_ms;
     double mean_tput;
+    long total_faults;
+    int errors;
 } Stats;
 
 static void print_results(char* name, Stats *stats) {
     printf("Results for %s malloc:\n", name);
-    printf("%-30s%7s %5s%8s%10s%8s\n", "trace", " valid", "util", "ops", "ms", "kops/s");
+    printf("%-30s%7s %5s%8s%10s%8s%8s\n", "trace", " valid", "util", "ops", "ms", "kops/s", "faults");
     for (int i = 0; i < stats->num_traces; i++) {
         if (stats->traces[i].valid) {
-            printf("%-27s%10s%5.0f%%%8.0f%10.2f%8.0f\n", traces[i], "yes",
+            printf("%-27s%10s%5.0f%%%8.0f%10.2f%8.0f%8ld\n", traces[i], "yes",
                 stats->traces[i].util*100.0,
                 stats->traces[i].ops,  stats->traces[i].ms,
-                stats->traces[i].ops / stats->traces[i].ms);
+                stats->traces[i].ops / stats->traces[i].ms,
+                stats->traces[i].faults);
         } else {
-            printf("%-27s%10s%6s%8s%10s%8s\n", traces[i], "no", "-", "-", "-", "-");
+            printf("%-27s%10s%6s%8s%10s%8s%8s\n", traces[i], "no", "-", "-", "-", "-", "-");
         }
     }
     if (errors == 0) {
-        printf("%12s%5.0f%%%8.0f%10.2f%8.0f\n",
+        printf("%12s%5.0f%%%8.0f%10.2f%8.0f%8ld\n",
             "Total                                ",
-            stats->mean_util*100.0, stats->total_ops, stats->total_ms, stats->mean_tput);
+            stats->mean_util*100.0, stats->total_ops, stats->total_ms, stats->mean_tput,
+            stats->total_faults);
     } else {
-        printf("%12s%6s%8s%10s%8s\n",
-        "Total                                ", "-", "-", "-", "-");
+        printf("%12s%6s%8s%10s%8s%8s\n",
+        "Total                                ", "-", "-", "-", "-", "-");
     }
     printf("\n");
 }
 
-static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, free_f test_free,
-        char *traces[], int traces_len, int repeat_min) {
+static Stats *eval(Allocator *alloc, hint_f test_hint, char *traces[], int traces_len,
+        int repeat_min) {
 
     Stats *stats = calloc(1, sizeof(Stats));
     if (stats == NULL) {
@@ -396,37 +625,39 @@ static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, fre
     stats->total_ops = 0.0;
     stats->total_ms = 0.0;
     stats->num_traces = traces_len;
+    errors = 0;
     for (int i = 0; i < traces_len; i++) {
-        if (strncmp(name, "mm", 2) == 0) {
-            if (i == 0) {
-                mem_init();
-            }
-            mem_reset_brk();
-            if (mm_init() < 0) {
-                trace_error(i, 0, "mm_init failed.");
-                stats->traces[i].valid = 0;
-                continue;
-            }
+        // start each trace on a heap without committed pages, to count faults
+        if (alloc->heapsize != NULL)
+            mem_decommit();
+        if (alloc_reset(alloc) < 0) {
+            trace_error(i, 0, "allocator init failed.");
+            stats->traces[i].valid = 0;
+            continue;
         }
 
         Trace *trace = read_trace(traces[i]);
         stats->traces[i].ops = trace->num_ops;
         stats->total_ops += stats->traces[i].ops;
 
-        int max_total_size = eval_valid(test_malloc, test_realloc, test_free, trace, i);
+        long faults = page_faults();
+        long heap_size = 0;
+        int max_total_size = eval_valid(alloc, test_hint, trace, i, &stats->traces[i].internal_frag,
+            &heap_size);
+        stats->traces[i].faults = page_faults() - faults;
+        stats->total_faults += stats->traces[i].faults;
         stats->traces[i].valid = max_total_size > 0;
 
         if (stats->traces[i].valid) {
-            if (strncmp(name, "mm", 2) == 0) {
-                stats->traces[i].util = ((double)max_total_size / mem_heapsize());
+            if (alloc->heapsize != NULL) {
+                stats->traces[i].util = ((double)max_total_size / heap_size);
                 stats->mean_util += stats->traces[i].util;
-                mem_reset_brk();
-                if (mm_init() < 0) {
-                    printf("mm_init failed in eval_speed\n");
+                if (alloc_reset(alloc) < 0) {
+                    printf("%s init failed in eval_speed\n", alloc->name);
                     exit(1);
                 }
             }
-            stats->traces[i].ms = eval_speed(test_malloc, test_realloc, test_free, trace, repeat_min, 10);
+            stats->traces[i].ms = eval_speed(alloc, test_hint, trace, repeat_min, 10);
             stats->total_ms += stats->traces[i].ms;
         }
 
@@ -435,23 +666,435 @@ static Stats *eval(char *name, malloc_f test_malloc, realloc_f test_realloc, fre
 
     stats->mean_util /= traces_len;
     stats->mean_tput = stats->total_ops / stats->total_ms;
+    stats->errors = errors;
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s", alloc->name, (test_hint != NULL) ? " (oracle)" : "");
     print_results(name, stats);
     return stats;
 }
 
+static void print_comparison(Allocator *allocs[], Stats *stats[], int num_allocs) {
+    printf("Comparison (util / kops/s):\n");
+    printf("%-27s", "trace");
+    for (int a = 0; a < num_allocs; a++)
+        printf("%16s", allocs[a]->name);
+    printf("\n");
+    for (int i = 0; i < traces_len; i++) {
+        printf("%-27s", traces[i]);
+        for (int a = 0; a < num_allocs; a++) {
+            TraceStats *ts = &stats[a]->traces[i];
+            if (!ts->valid)
+                printf("%16s", "-");
+            else if (allocs[a]->heapsize != NULL)
+                printf("%7.0f%% %7.0f", ts->util*100.0, ts->ops / ts->ms);
+            else
+                printf("%8s %7.0f", "-", ts->ops / ts->ms);
+        }
+        printf("\n");
+    }
+    printf("%-27s", "Total");
+    for (int a = 0; a < num_allocs; a++) {
+        if (allocs[a]->heapsize != NULL)
+            printf("%7.0f%% %7.0f", stats[a]->mean_util*100.0, stats[a]->mean_tput);
+        else
+            printf("%8s %7.0f", "-", stats[a]->mean_tput);
+    }
+    printf("\n\n");
+
+    printf("Internal fragmentation at peak:\n");
+    printf("%-27s", "trace");
+    for (int a = 0; a < num_allocs; a++)
+        printf("%16s", allocs[a]->name);
+    printf("\n");
+    for (int i = 0; i < traces_len; i++) {
+        printf("%-27s", traces[i]);
+        for (int a = 0; a < num_allocs; a++) {
+            TraceStats *ts = &stats[a]->traces[i];
+            if (ts->valid && allocs[a]->allocated != NULL)
+                printf("%15.1f%%", ts->internal_frag*100.0);
+            else
+                printf("%16s", "-");
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+static void print_index(char *name, Stats *mm_stats, Stats *libc_stats) {
+    double util_weight = 0.6;
+    double p1 = util_weight * mm_stats->mean_util / 0.95;
+    double p2 = (1.0 - util_weight) * fmin(1.0, mm_stats->mean_tput / (0.9 * libc_stats->mean_tput));
+    if (name == NULL)
+        printf("PERFORMANCE INDEX: ");
+    else
+        printf("PERFORMANCE INDEX [%s]: ", name);
+    printf("%.0f (util) + %.0f (thru) = %.0f/100\n", p1*100, p2*100, (p1 + p2)*100.0);
+}
+
+/* evaluate all selected allocators on the current memlib heap */
+static Stats **eval_all(Allocator *selected[], int num_selected, int compare, int repeat_min) {
+    Stats **stats = calloc(num_selected, sizeof(Stats *));
+    if (stats == NULL) {
+        perror("stats allocation3 failed");
+        exit(1);
+    }
+
+    Stats *libc_stats = NULL;
+    int total_errors = 0;
+    for (int a = 0; a < num_selected; a++) {
+        stats[a] = eval(selected[a], NULL, traces, traces_len, repeat_min);
+        total_errors += stats[a]->errors;
+        if (strcmp(selected[a]->name, "libc") == 0)
+            libc_stats = stats[a];
+    }
+
+    if (compare && num_selected > 1)
+        print_comparison(selected, stats, num_selected);
+
+    if (total_errors != 0)
+        printf("Terminated with %d errors\n", total_errors);
+
+    if (libc_stats != NULL && libc_stats->errors == 0) {
+        // a single mm variant keeps the classic one-line index
+        int num_heap = 0;
+        for (int a = 0; a < num_selected; a++)
+            num_heap += selected[a]->heapsize != NULL;
+        for (int a = 0; a < num_selected; a++) {
+            if (selected[a]->heapsize != NULL && stats[a]->errors == 0)
+                print_index(num_heap > 1 ? selected[a]->name : NULL, stats[a], libc_stats);
+        }
+    }
+    return stats;
+}
+
+/* page faults of the memlib allocators, one column per (mode, allocator) */
+static void print_faults(MemMode *modes[], int num_modes, Allocator *selected[], int num_selected,
+        Stats **stats[]) {
+    printf("\nPage faults per trace:\n");
+    printf("%-27s", "trace");
+    for (int m = 0; m < num_modes; m++) {
+        for (int a = 0; a < num_selected; a++) {
+            if (selected[a]->heapsize != NULL) {
+                char column[64];
+                snprintf(column, sizeof(column), "%s/%s", modes[m]->name, selected[a]->name);
+                printf("%16s", column);
+            }
+        }
+    }
+    printf("\n");
+    for (int i = 0; i <= traces_len; i++) {
+        printf("%-27s", (i < traces_len) ? traces[i] : "Total");
+        for (int m = 0; m < num_modes; m++) {
+            for (int a = 0; a < num_selected; a++) {
+                if (selected[a]->heapsize == NULL)
+                    continue;
+                if (i == traces_len)
+                    printf("%16ld", stats[m][a]->total_faults);
+                else if (stats[m][a]->traces[i].valid)
+                    printf("%16ld", stats[m][a]->traces[i].faults);
+                else
+                    printf("%16s", "-");
+            }
+        }
+        printf("\n");
+    }
+}
+
+/* realloc microbenchmark (-b): grow a block that cannot be extended in place */
+#define BENCH_MIN_SIZE (64 * (1 << 10))
+#define BENCH_MAX_SIZE (8 * (1 << 20))
+#define BENCH_GROWTH 4096
+
+/**
+ * Time one realloc of a `size`-byte block, on a fresh heap.
+ *
+ * @return microseconds spent in realloc, or -1 on error
+ */
+static double bench_realloc(Allocator *alloc, int size) {
+    if (alloc->heapsize != NULL)
+        mem_decommit();
+    if (alloc_reset(alloc) < 0)
+        return -1;
+
+    char *p = alloc->malloc_fn(size);
+    char *guard = alloc->malloc_fn(16);  // so that p cannot grow in place
+    if (p == NULL || guard == NULL)
+        return -1;
+    memset(p, 0x5a, size);
+
+    struct timespec t0;
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    char *q = alloc->realloc_fn(p, size + BENCH_GROWTH);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (q == NULL || q[0] != 0x5a || q[size / 2] != 0x5a || q[size - 1] != 0x5a)
+        return -1;
+
+    alloc->free_fn(q);
+    alloc->free_fn(guard);
+    return (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+}
+
+/* print the best realloc time per block size, one column per (mode, allocator) */
+static void run_realloc_bench(MemMode *modes[], int num_modes, long limit,
+        Allocator *selected[], int num_selected, int repeat_min) {
+    int num_sizes = 0;
+    for (int size = BENCH_MIN_SIZE; size <= BENCH_MAX_SIZE; size *= 2)
+        num_sizes++;
+    double *us = calloc(num_modes * num_selected * num_sizes, sizeof(double));
+    if (us == NULL) {
+        perror("bench allocation failed");
+        exit(1);
+    }
+
+    for (int m = 0; m < num_modes; m++) {
+        MemConfig config = modes[m]->config;
+        config.limit = limit;
+        mem_configure(&config);
+        mem_init();
+        for (int a = 0; a < num_selected; a++) {
+            for (int i = 0; i < num_sizes; i++) {
+                double best = DBL_MAX;
+                for (int r = 0; r < repeat_min && best >= 0; r++)
+                    best = fmin(best, bench_realloc(selected[a], BENCH_MIN_SIZE << i));
+                us[(m * num_selected + a) * num_sizes + i] = best;
+            }
+        }
+        mem_deinit();
+    }
+
+    printf("Realloc of a block grown by %d bytes (us):\n", BENCH_GROWTH);
+    printf("%-10s", "size");
+    for (int m = 0; m < num_modes; m++) {
+        for (int a = 0; a < num_selected; a++) {
+            char column[64];
+            snprintf(column, sizeof(column), "%s/%s", modes[m]->name, selected[a]->name);
+            printf("%16s", column);
+        }
+    }
+    printf("\n");
+    for (int i = 0; i < num_sizes; i++) {
+        printf("%7d KB", (BENCH_MIN_SIZE << i) >> 10);
+        for (int c = 0; c < num_modes * num_selected; c++) {
+            double t = us[c * num_sizes + i];
+            if (t < 0)
+                printf("%16s", "error");
+            else
+                printf("%16.1f", t);
+        }
+        printf("\n");
+    }
+    free(us);
+}
+
 static void usage(void) {
-    fprintf(stderr, "Usage: mtest [-h] [-r <reps>] [-f <file>]\nwhere\n");
+    fprintf(stderr, "Usage: mtest [-h] [-b] [-s] [-o] [-r <reps>] [-f <file>] [-a <names>] [-m <modes>] [-l <MB>]\nwhere\n");
     fprintf(stderr, "-h         Print program usage.\n");
+    fprintf(stderr, "-b         Run the realloc microbenchmark instead of the traces.\n");
+    fprintf(stderr, "-s         Run the call-site benchmark (single heap vs heaps per call site).\n");
+    fprintf(stderr, "-o         Replay the traces knowing each block's lifetime, and print the gain.\n");
     fprintf(stderr, "-r <reps>  Repeat measurements <reps> times. (default: 3)\n");
     fprintf(stderr, "-t <trace> Use only <trace> as the trace file.\n");
+    fprintf(stderr, "-a <names> Comma-separated allocators to compare. (default: libc,mm)\n");
+    fprintf(stderr, "           Available:");
+    for (int i = 0; i < allocators_len; i++)
+        fprintf(stderr, " %s", allocators[i].name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "-m <modes> Comma-separated memlib heap modes to run. (default: lazy)\n");
+    fprintf(stderr, "           Available:");
+    for (int i = 0; i < mem_modes_len; i++)
+        fprintf(stderr, " %s", mem_modes[i].name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "-l <MB>    Limit the memlib heap to <MB> megabytes. (default: 40)\n");
+}
+
+/* call-site benchmark: objects of four lifetimes from four call sites */
+#define SITE_ITERATIONS 200000
+#define SITE_RING 512         // medium-lived objects are freed 512 iterations later
+#define SITE_SESSION 2000     // session objects are all freed every 2000 iterations
+
+static unsigned site_rand_state;
+
+static int site_rand(int lo, int hi) {
+    site_rand_state = site_rand_state * 1103515245 + 12345;
+    return lo + (site_rand_state >> 8) % (hi - lo + 1);
+}
+
+// one function per site, so that each has its own return address
+__attribute__((noinline)) static void *site_temp(size_t size) { return mm_malloc(size); }
+__attribute__((noinline)) static void *site_medium(size_t size) { return mm_malloc(size); }
+__attribute__((noinline)) static void *site_session(size_t size) { return mm_malloc(size); }
+__attribute__((noinline)) static void *site_long(size_t size) { return mm_malloc(size); }
+
+/**
+ * Run the call-site workload once on the mm heap(s).
+ *
+ * @param heaps number of heaps (see `mm_set_site_heaps`)
+ * @param util set to the peak of live payload bytes over the heap size
+ * @return elapsed milliseconds, or -1 on error
+ */
+static double bench_sites(int heaps, double *util) {
+    static void *ring[SITE_RING];
+    static void *session[SITE_SESSION];
+    static int ring_size[SITE_RING];
+    static int session_size[SITE_SESSION];
+    memset(ring, 0, sizeof(ring));
+    site_rand_state = 1;
+    long live = 0;
+    long peak = 0;
+
+    mem_reset_brk();
+    mm_set_site_heaps(heaps);
+    if (mm_init() < 0)
+        return -1;
+
+    struct timespec t0;
+    struct timespec t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < SITE_ITERATIONS; i++) {
+        int temp_size = site_rand(64, 1088);
+        char *temp = site_temp(temp_size);
+
+        int r = i % SITE_RING;
+        mm_free(ring[r]);
+        live -= ring_size[r];
+        ring_size[r] = site_rand(32, 544);
+        ring[r] = site_medium(ring_size[r]);
+
+        int s = i % SITE_SESSION;
+        session_size[s] = site_rand(100, 400);
+        session[s] = site_session(session_size[s]);
+        live += ring_size[r] + session_size[s] + temp_size;
+
+        if (i % 16 == 0) {
+            int long_size = site_rand(16, 272);
+            if (site_long(long_size) == NULL)
+                return -1;
+            live += long_size;
+        }
+        if (temp == NULL || ring[r] == NULL || session[s] == NULL)
+            return -1;
+        temp[0] = 1;
+        peak = MAX(peak, live);
+
+        mm_free(temp);
+        live -= temp_size;
+        if (s == SITE_SESSION - 1) {
+            for (int j = 0; j < SITE_SESSION; j++) {
+                mm_free(session[j]);
+                live -= session_size[j];
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    *util = (double)peak / mm_heapsize();
+    mm_set_site_heaps(0);
+    mm_init();  // releases the site heaps
+    return (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0;
+}
+
+static void run_site_bench(MemMode *mode, long limit, int repeat_min) {
+    MemConfig config = mode->config;
+    config.limit = limit;
+    mem_configure(&config);
+    mem_init();
+
+    long ops = SITE_ITERATIONS * 6L + SITE_ITERATIONS / 16;
+    printf("Call-site benchmark (%d iterations, 4 allocation sites):\n", SITE_ITERATIONS);
+    printf("%-8s%8s%10s\n", "heaps", "util", "Kops/s");
+    int counts[] = {1, 2, 4};
+    for (int c = 0; c < 3; c++) {
+        double util = 0;
+        double best = DBL_MAX;
+        for (int r = 0; r < repeat_min && best >= 0; r++)
+            best = fmin(best, bench_sites(counts[c], &util));
+        if (best < 0)
+            printf("%-8d%18s\n", counts[c], "error");
+        else
+            printf("%-8d%7.0f%%%10.0f\n", counts[c], util * 100.0, ops / best);
+    }
+    mem_deinit();
+}
+
+/**
+ * Replay the traces with and without the exact lifetime of each allocation
+ * (known from the trace), and print what the oracle gains per trace: an upper
+ * bound for any lifetime prediction.
+ */
+static void run_oracle(MemMode *mode, long limit, Allocator *selected[], int num_selected,
+        int repeat_min) {
+    MemConfig config = mode->config;
+    config.limit = limit;
+    mem_configure(&config);
+    mem_init();
+    for (int a = 0; a < num_selected; a++) {
+        Allocator *alloc = selected[a];
+        if (alloc->hint_fn == NULL) {
+            printf("No lifetime hook for %s malloc\n\n", alloc->name);
+            continue;
+        }
+        Stats *base = eval(alloc, NULL, traces, traces_len, repeat_min);
+        Stats *oracle = eval(alloc, alloc->hint_fn, traces, traces_len, repeat_min);
+
+        printf("Oracle lifetimes for %s malloc (util / kops/s):\n", alloc->name);
+        printf("%-27s%16s%16s%16s\n", "trace", "base", "oracle", "gain");
+        for (int i = 0; i <= traces_len; i++) {
+            printf("%-27s", (i < traces_len) ? traces[i] : "Total");
+            double util[2];
+            double tput[2];
+            Stats *both[2] = {base, oracle};
+            int valid = 1;
+            for (int k = 0; k < 2; k++) {
+                if (i == traces_len) {
+                    valid &= both[k]->errors == 0;
+                    util[k] = both[k]->mean_util;
+                    tput[k] = both[k]->mean_tput;
+                } else {
+                    valid &= both[k]->traces[i].valid;
+                    util[k] = both[k]->traces[i].util;
+                    tput[k] = both[k]->traces[i].ops / both[k]->traces[i].ms;
+                }
+            }
+            if (!valid) {
+                printf("%16s%16s%16s\n", "-", "-", "-");
+                continue;
+            }
+            printf("%7.0f%% %7.0f%7.0f%% %7.0f%+6.0f%% %+7.0f%%\n",
+                util[0] * 100.0, tput[0], util[1] * 100.0, tput[1],
+                (util[1] - util[0]) * 100.0, (tput[1] / tput[0] - 1.0) * 100.0);
+        }
+        printf("\n");
+        free(base->traces);
+        free(base);
+        free(oracle->traces);
+        free(oracle);
+    }
+    mem_deinit();
 }
 
 int main(int argc, char **argv) {
     int repeat_min = 3;
+    char *names = "libc,mm";
+    char *mode_names = "lazy";
+    long limit = 0;
+    int compare = 0;
+    int bench = 0;
+    int site_bench = 0;
+    int oracle = 0;
 
     char c;
-    while ((c = getopt(argc, argv, "f:r:h")) != EOF) {
+    while ((c = getopt(argc, argv, "f:r:a:m:l:bsoh")) != EOF) {
         switch (c) {
+            case 'b':
+                bench = 1;
+                break;
+            case 's':
+                site_bench = 1;
+                break;
+            case 'o':
+                oracle = 1;
+                break;
             case 'f':
                 traces[0] = strdup(optarg);
                 traces_len = 1;
@@ -459,6 +1102,16 @@ int main(int argc, char **argv) {
             case 'r':
                 repeat_min = atoi(optarg);
                 break;
+            case 'a':
+                names = optarg;
+                compare = 1;
+                break;
+            case 'm':
+                mode_names = optarg;
+                break;
+            case 'l':
+                limit = atol(optarg) * (1 << 20);
+                break;
             case 'h':
                 usage();
                 exit(0);
@@ -468,21 +1121,79 @@ int main(int argc, char **argv) {
         }
     }
 
-    errors = 0;
-    Stats *libc_stats = eval("libc", malloc, realloc, free, traces, traces_len, repeat_min);
-    errors = 0;
-    Stats *mm_stats = eval("mm", mm_malloc, mm_realloc, mm_free, traces, traces_len, repeat_min);
+    // resolve the allocator and mode names before running anything
+    Allocator *selected[sizeof(allocators) / sizeof(allocators[0])];
+    int num_selected = 0;
+    char *names_copy = strdup(names);
+    for (char *name = strtok(names_copy, ","); name != NULL; name = strtok(NULL, ",")) {
+        Allocator *alloc = find_allocator(name);
+        if (alloc == NULL) {
+            fprintf(stderr, "Unknown allocator: %s\n", name);
+            usage();
+            exit(1);
+        }
+        if (num_selected == allocators_len) {
+            fprintf(stderr, "Too many allocators in -a %s\n", names);
+            exit(1);
+        }
+        selected[num_selected++] = alloc;
+    }
+    free(names_copy);
 
-    if (errors != 0) {
-        printf("Terminated with %d errors\n", errors);
-    } else {
-        double util_weight = 0.6;
-        double p1 = util_weight * mm_stats->mean_util / 0.95;
-        double p2 = (1.0 - util_weight) * fmin(1.0, mm_stats->mean_tput / (0.9 * libc_stats->mean_tput));
-        printf("PERFORMANCE INDEX: %.0f (util) + %.0f (thru) = %.0f/100\n", p1*100, p2*100, (p1 + p2)*100.0);
+    MemMode *modes[sizeof(mem_modes) / sizeof(mem_modes[0])];
+    int num_modes = 0;
+    names_copy = strdup(mode_names);
+    for (char *name = strtok(names_copy, ","); name != NULL; name = strtok(NULL, ",")) {
+        MemMode *mode = find_mem_mode(name);
+        if (mode == NULL) {
+            fprintf(stderr, "Unknown heap mode: %s\n", name);
+            usage();
+            exit(1);
+        }
+        if (num_modes == mem_modes_len) {
+            fprintf(stderr, "Too many heap modes in -m %s\n", mode_names);
+            exit(1);
+        }
+        modes[num_modes++] = mode;
+    }
+    free(names_copy);
+
+    if (bench) {
+        run_realloc_bench(modes, num_modes, limit, selected, num_selected, repeat_min);
+        exit(0);
+    }
+    if (site_bench) {
+        run_site_bench(modes[0], limit, repeat_min);
+        exit(0);
+    }
+    if (oracle) {
+        run_oracle(modes[0], limit, selected, num_selected, repeat_min);
+        exit(0);
     }
 
-    free(libc_stats);
-    free(mm_stats);
+    Stats **stats[sizeof(mem_modes) / sizeof(mem_modes[0])];
+    for (int m = 0; m < num_modes; m++) {
+        MemConfig config = modes[m]->config;
+        config.limit = limit;
+        mem_configure(&config);
+        mem_init();
+        if (num_modes > 1)
+            printf("=== Heap mode: %s\n\n", modes[m]->name);
+        stats[m] = eval_all(selected, num_selected, compare, repeat_min);
+        if (num_modes > 1)
+            printf("\n");
+        mem_deinit();
+    }
+
+    if (num_modes > 1)
+        print_faults(modes, num_modes, selected, num_selected, stats);
+
+    for (int m = 0; m < num_modes; m++) {
+        for (int a = 0; a < num_selected; a++) {
+            free(stats[m][a]->traces);
+            free(stats[m][a]);
+        }
+        free(stats[m]);
+    }
     exit(0);
 }
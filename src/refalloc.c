@@ -0,0 +1,248 @@
+#include "refalloc.h"  // prototypes of functions implemented in this file
+#include "mm_block.h"  // "mm_block_..." functions -- reused by the implicit list
+#include "memlib.h"    // mem_sbrk -- to extend the heap
+#include <string.h>    // memcpy -- to copy regions of memory
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+/**
+ * Round up to a block size (multiple of 8) with room for a 4-byte header.
+ */
+static int header_block_size(size_t payload_size) {
+    return ((payload_size + 4 + 7) / 8) * 8;
+}
+
+/*
+ * Bump allocator.
+ *
+ * Blocks are carved one after the other from the top of the heap, with
+ * exactly the requested size, and are never reused: this is an upper bound on
+ * throughput, and the heap growth of a trace without any reuse (so it fails
+ * on traces that need reuse to fit in the heap). Each block keeps its size in
+ * a 4-byte header, so that realloc knows how many bytes to copy. A block that
+ * grows moves to a new block, unless it is the last one.
+ */
+
+static char *bump_top;         // header address of the next block
+static BlockHeader *bump_last; // last block, the only one that can grow in place
+
+/**
+ * Move the bump pointer by `size` bytes, extending the heap if needed.
+ *
+ * @return the old bump pointer, or `NULL` if the heap is full
+ */
+static char *bump(int size) {
+    char *brk = mem_heap_hi() + 1;
+    if (bump_top + size > brk && (long)mem_sbrk(bump_top + size - brk) == -1)
+        return NULL;
+    char *old_top = bump_top;
+    bump_top += size;
+    return old_top;
+}
+
+int ref_bump_init(void) {
+    // skip 4 bytes so that payloads (after a 4-byte header) are 8-byte aligned
+    char *pad = mem_sbrk(4);
+    if ((long)pad == -1)
+        return -1;
+    bump_top = pad + 4;
+    bump_last = NULL;
+    return 0;
+}
+
+void *ref_bump_malloc(size_t size) {
+    if (size == 0)
+        return NULL;
+
+    int block_size = header_block_size(size);
+    char *bp = bump(block_size);
+    if (bp == NULL)
+        return NULL;
+
+    bump_last = (BlockHeader *)bp;
+    *bump_last = block_size;
+    return bp + 4;
+}
+
+void *ref_bump_realloc(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return ref_bump_malloc(size);
+    if (size == 0) {
+        ref_bump_free(ptr);
+        return NULL;
+    }
+
+    BlockHeader *bp = (BlockHeader *)((char *)ptr - 4);
+    int old_size = *bp;
+    int block_size = header_block_size(size);
+    if (block_size <= old_size)
+        return ptr;
+
+    // the last block grows by moving the bump pointer
+    if (bp == bump_last) {
+        if (bump(block_size - old_size) == NULL)
+            return NULL;
+        *bp = block_size;
+        return ptr;
+    }
+
+    void *new_ptr = ref_bump_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, old_size - 4);
+    return new_ptr;
+}
+
+void ref_bump_free(void *ptr) {
+    (void)ptr;  // memory is never reused
+}
+
+/*
+ * Implicit free list.
+ *
+ * The textbook allocator (Section 9.9.12): same block format as `mm` (headers
+ * and footers written by the `mm_block_...` functions), but no free list, so
+ * that every search walks all blocks of the heap.
+ */
+
+/**
+ * Points to the prologue block of the implicit list.
+ */
+static BlockHeader *implicit_blocks;
+
+/**
+ * Coalesce a free block with its free neighbors.
+ *
+ * @param bp address of the header of a free block
+ * @return the address of the coalesced block
+ */
+static BlockHeader *implicit_coalesce(BlockHeader *bp) {
+    int size = mm_block_size(bp);
+    BlockHeader *next = mm_block_next(bp);
+    if (!mm_block_allocated(next))
+        size += mm_block_size(next);
+    if (!mm_block_allocated(bp - 1)) {  // footer of the previous block
+        bp = mm_block_prev(bp);
+        size += mm_block_size(bp);
+    }
+    mm_block_set_header(bp, size, 0);
+    mm_block_set_footer(bp, size, 0);
+    return bp;
+}
+
+/**
+ * Add a free block of `size` bytes at the end of the heap.
+ *
+ * @param size number of bytes (multiple of 8)
+ * @return the (coalesced) free block, or `NULL` if the heap is full
+ */
+static BlockHeader *implicit_extend(int size) {
+    char *bp = mem_sbrk(size);
+    if ((long)bp == -1)
+        return NULL;
+
+    BlockHeader *old_epilogue = (BlockHeader *)bp - 1;
+    mm_block_set_header(old_epilogue, size, 0);
+    mm_block_set_footer(old_epilogue, size, 0);
+    mm_block_set_header(mm_block_next(old_epilogue), 0, 1);
+    return implicit_coalesce(old_epilogue);
+}
+
+/**
+ * Allocate `size` bytes at the beginning of a free block, splitting it if the
+ * remainder can hold a block.
+ */
+static void implicit_place(BlockHeader *bp, int size) {
+    int old_size = mm_block_size(bp);
+    if (old_size - size >= 16) {
+        mm_block_set_header(bp, size, 1);
+        mm_block_set_footer(bp, size, 1);
+        BlockHeader *rest = mm_block_next(bp);
+        mm_block_set_header(rest, old_size - size, 0);
+        mm_block_set_footer(rest, old_size - size, 0);
+    } else {
+        mm_block_set_header(bp, old_size, 1);
+        mm_block_set_footer(bp, old_size, 1);
+    }
+}
+
+int ref_implicit_init(void) {
+    // same layout as mm_init: padding, prologue and epilogue
+    char *new_region = mem_sbrk(16);
+    if ((long)new_region == -1)
+        return -1;
+
+    implicit_blocks = (BlockHeader *)new_region;
+    mm_block_set_header(implicit_blocks, 0, 0);
+    mm_block_set_header(implicit_blocks + 1, 8, 1);
+    mm_block_set_footer(implicit_blocks + 1, 8, 1);
+    mm_block_set_header(implicit_blocks + 3, 0, 1);
+    implicit_blocks += 1;
+    return 0;
+}
+
+void *ref_implicit_malloc(size_t size) {
+    if (size == 0)
+        return NULL;
+
+    int required_size = ((size + 8 + 7) / 8) * 8;  // header and footer
+
+    // first fit over all blocks, up to the epilogue
+    BlockHeader *bp = mm_block_next(implicit_blocks);
+    while (mm_block_size(bp) > 0) {
+        if (!mm_block_allocated(bp) && mm_block_size(bp) >= required_size)
+            break;
+        bp = mm_block_next(bp);
+    }
+
+    if (mm_block_size(bp) == 0) {
+        bp = implicit_extend(MAX(required_size, 512));
+        if (bp == NULL)
+            return NULL;
+    }
+
+    implicit_place(bp, required_size);
+    return mm_block_payload_addr(bp);
+}
+
+void ref_implicit_free(void *ptr) {
+    if (ptr == NULL)
+        return;
+
+    BlockHeader *bp = (BlockHeader *)((char *)ptr - 4);
+    int size = mm_block_size(bp);
+    mm_block_set_header(bp, size, 0);
+    mm_block_set_footer(bp, size, 0);
+    implicit_coalesce(bp);
+}
+
+void *ref_implicit_realloc(void *ptr, size_t size) {
+    if (ptr == NULL)
+        return ref_implicit_malloc(size);
+    if (size == 0) {
+        ref_implicit_free(ptr);
+        return NULL;
+    }
+
+    BlockHeader *bp = (BlockHeader *)((char *)ptr - 4);
+    int old_size = mm_block_size(bp);
+    int required_size = ((size + 8 + 7) / 8) * 8;
+    if (required_size <= old_size)
+        return ptr;
+
+    // absorb the next block if free and large enough
+    BlockHeader *next = mm_block_next(bp);
+    if (!mm_block_allocated(next) && old_size + mm_block_size(next) >= required_size) {
+        int combined_size = old_size + mm_block_size(next);
+        mm_block_set_header(bp, combined_size, 0);
+        implicit_place(bp, required_size);
+        return ptr;
+    }
+
+    void *new_ptr = ref_implicit_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+    memcpy(new_ptr, ptr, old_size - 8);
+    ref_implicit_free(ptr);
+    return new_ptr;
+}
@@ -0,0 +1,24 @@
+#ifndef __REFALLOC_H__
+#define __REFALLOC_H__
+
+#include <stddef.h>  // size_t
+
+/**
+ * Reference allocators used by `mtest` as comparison baselines. They all take
+ * memory from the same `memlib` heap as `mm`, so utilization is comparable.
+ * (The buddy allocator is a full backend, in `mm_buddy.h`.)
+ */
+
+// bump allocator: never reuses freed memory
+int   ref_bump_init(void);
+void *ref_bump_malloc(size_t size);
+void *ref_bump_realloc(void *ptr, size_t size);
+void  ref_bump_free(void *ptr);
+
+// implicit free list: first fit over all blocks, immediate coalescing
+int   ref_implicit_init(void);
+void *ref_implicit_malloc(size_t size);
+void *ref_implicit_realloc(void *ptr, size_t size);
+void  ref_implicit_free(void *ptr);
+
+#endif /* __REFALLOC_H__ */
@@ -0,0 +1,204 @@
+#define _GNU_SOURCE  // before unity.h includes libc headers (see memlib.c)
+
+#include "unity.h"
+
+#include "memlib.c"
+#include <string.h>
+#include <sys/resource.h>  // getrusage
+
+static void init(MemBacking backing, long limit, int prefault) {
+    MemConfig config = {backing, limit, prefault, 0, NULL};
+    mem_configure(&config);
+    mem_init();
+}
+
+void setUp(void) {
+
+}
+
+void tearDown(void) {
+    mem_deinit();
+}
+
+void test_commit_in_chunks(void) {
+    init(MEM_BACKING_ANON, 0, 0);
+    TEST_ASSERT(mem->max_addr - mem->start_brk == MAX_HEAP);
+    TEST_ASSERT(mem->commit_brk == mem->start_brk);
+
+    char *p = mem_sbrk(100);
+    TEST_ASSERT(p == mem_heap_lo());
+    TEST_ASSERT(mem->commit_brk - mem->start_brk == COMMIT_CHUNK);
+    p[99] = 1;
+
+    p = mem_sbrk(COMMIT_CHUNK);
+    TEST_ASSERT(p == mem_heap_lo() + 100);
+    TEST_ASSERT(mem->commit_brk - mem->start_brk == 2 * COMMIT_CHUNK);
+    p[COMMIT_CHUNK - 1] = 1;
+    TEST_ASSERT(mem_heapsize() == COMMIT_CHUNK + 100);
+}
+
+void test_limit(void) {
+    init(MEM_BACKING_ANON, 3 * COMMIT_CHUNK, 1);
+    TEST_ASSERT(mem_sbrk(2 * COMMIT_CHUNK) != (void *)-1);
+    TEST_ASSERT(mem_sbrk(COMMIT_CHUNK) != (void *)-1);
+    TEST_ASSERT(mem_sbrk(1) == (void *)-1);
+    TEST_ASSERT(mem_heapsize() == 3 * COMMIT_CHUNK);
+}
+
+void test_top_break(void) {
+    init(MEM_BACKING_ANON, 3 * COMMIT_CHUNK, 0);
+    char *top = mem_sbrk_top(1000);
+    TEST_ASSERT(top == mem->max_addr - 1000);
+    top[0] = 1;
+    top[999] = 1;
+    TEST_ASSERT(mem_contains(top, top + 999));
+    TEST_ASSERT(mem_heapsize() == 1000);
+
+    // the breaks never cross
+    TEST_ASSERT(mem_sbrk(3 * COMMIT_CHUNK - 999) == (void *)-1);
+    TEST_ASSERT(mem_sbrk(3 * COMMIT_CHUNK - 1000) != (void *)-1);
+    TEST_ASSERT(mem_brk_avail() == 0);
+    TEST_ASSERT(mem_sbrk_top(8) == (void *)-1);
+
+    // trimming the top leaves room for the bottom break
+    TEST_ASSERT(mem_trim_top(1000) == 0);
+    TEST_ASSERT(mem_trim_top(8) == -1);
+    TEST_ASSERT(mem_sbrk(1000) != (void *)-1);
+    TEST_ASSERT(mem_heapsize() == 3 * COMMIT_CHUNK);
+}
+
+void test_decommit(void) {
+    init(MEM_BACKING_ANON, 0, 0);
+    char *p = mem_sbrk(1000);
+    p[0] = 42;
+    mem_decommit();
+    TEST_ASSERT(mem_heapsize() == 0);
+    TEST_ASSERT(mem->commit_brk == mem->start_brk);
+
+    // pages come back zeroed at the same addresses
+    TEST_ASSERT(mem_sbrk(1000) == p);
+    TEST_ASSERT(p[0] == 0);
+}
+
+void test_prefault(void) {
+    init(MEM_BACKING_ANON, 4 * COMMIT_CHUNK, 1);
+    TEST_ASSERT(mem->commit_brk - mem->start_brk == 4 * COMMIT_CHUNK);
+
+    // the whole range is populated up front, and again after a decommit
+    char *p = mem_sbrk(1000);
+    p[0] = 42;
+    mem_decommit();
+    TEST_ASSERT(mem->commit_brk - mem->start_brk == 4 * COMMIT_CHUNK);
+    struct rusage before;
+    struct rusage after;
+    getrusage(RUSAGE_SELF, &before);
+    p = mem_sbrk(4 * COMMIT_CHUNK);
+    for (long i = 0; i < 4 * COMMIT_CHUNK; i += mem_page_size)
+        p[i] = 1;
+    TEST_ASSERT(mem_trim(4 * COMMIT_CHUNK) == 0);  // pages are kept
+    TEST_ASSERT(mem_sbrk(4 * COMMIT_CHUNK) == p);
+    p[0] = 1;
+    getrusage(RUSAGE_SELF, &after);
+    TEST_ASSERT(after.ru_minflt == before.ru_minflt);
+}
+
+void test_malloc_backing(void) {
+    init(MEM_BACKING_MALLOC, 1 << 20, 0);
+    char *p = mem_sbrk(1 << 19);
+    TEST_ASSERT(p == mem_heap_lo());
+    p[(1 << 19) - 1] = 1;
+    mem_decommit();  // only rewinds the break
+    TEST_ASSERT(mem_heapsize() == 0);
+    TEST_ASSERT(mem_sbrk((1 << 20) + 1) == (void *)-1);
+}
+
+void test_regions(void) {
+    init(MEM_BACKING_ANON, COMMIT_CHUNK, 0);
+    char *p = mem_sbrk(COMMIT_CHUNK);
+    TEST_ASSERT(mem_brk_avail() == 0);
+
+    char *r = mem_region(10000);
+    TEST_ASSERT(r != (void *)-1);
+    r[9999] = 1;
+    TEST_ASSERT(r + mem->regions[0].size == mem->map);  // just below the reserved range
+    TEST_ASSERT(mem_contains(p, p + COMMIT_CHUNK - 1));
+    TEST_ASSERT(mem_contains(r, r + 9999));
+    TEST_ASSERT(!mem_contains(p, p + COMMIT_CHUNK));
+    TEST_ASSERT(mem_heapsize() == COMMIT_CHUNK + mem->regions[0].size);
+
+    mem_reset_brk();
+    TEST_ASSERT(mem_heapsize() == 0);
+    TEST_ASSERT(mem->regions_len == 0);
+}
+
+void test_remap(void) {
+    init(MEM_BACKING_MEMFD, 0, 0);
+    long page = mem_page_size;
+    char *p = mem_sbrk(4 * page);
+    memset(p, 'a', page);
+    memset(p + 2 * page, 'b', 2 * page);
+    TEST_ASSERT(mem_can_remap());
+
+    // pages are exchanged, not copied
+    TEST_ASSERT(mem_remap(p + 2 * page, p, page) == 0);
+    TEST_ASSERT(p[2 * page] == 'a' && p[3 * page - 1] == 'a');
+    TEST_ASSERT(p[0] == 'b' && p[page - 1] == 'b');
+    TEST_ASSERT(mem->file_page[0] == 2 && mem->file_page[2] == 0);
+
+    // the source now spans two runs of file pages
+    TEST_ASSERT(mem_remap(p, p + 2 * page, 2 * page) == 0);
+    TEST_ASSERT(p[0] == 'a' && p[page] == 'b' && p[2 * page] == 'b');
+
+    TEST_ASSERT(mem_remap(p, p + page, 2 * page) == -1);  // overlapping
+    TEST_ASSERT(mem_remap(p + 1, p + 2 * page, page) == -1);  // not aligned
+
+    mem_decommit();
+    TEST_ASSERT(mem->file_page[0] == 0);
+}
+
+void test_remap_anon(void) {
+    init(MEM_BACKING_ANON, 0, 0);
+    long page = mem_page_size;
+    char *p = mem_sbrk(2 * page);
+    TEST_ASSERT(!mem_can_remap());
+    TEST_ASSERT(mem_remap(p + page, p, page) == -1);
+}
+
+void test_select(void) {
+    init(MEM_BACKING_ANON, 0, 0);
+    char *p = mem_sbrk(100);
+
+    MemConfig config = {MEM_BACKING_ANON, COMMIT_CHUNK, 0, 0, NULL};
+    MemHeap *other = mem_create(&config);
+    TEST_ASSERT(mem_select(other) == &mem_default);
+    mem_init();
+    char *q = mem_sbrk(200);
+    TEST_ASSERT(q != (void *)-1 && q != p);
+    TEST_ASSERT(mem_heapsize() == 200);
+    TEST_ASSERT(mem_brk_avail() == COMMIT_CHUNK - 200);
+
+    // each heap keeps its own break
+    TEST_ASSERT(mem_select(NULL) == other);
+    TEST_ASSERT(mem_heapsize() == 100);
+    TEST_ASSERT(mem_sbrk(8) == p + 100);
+
+    mem_select(other);
+    mem_destroy(other);
+    TEST_ASSERT(mem == &mem_default);
+    TEST_ASSERT(mem_heapsize() == 108);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commit_in_chunks);
+    RUN_TEST(test_limit);
+    RUN_TEST(test_top_break);
+    RUN_TEST(test_decommit);
+    RUN_TEST(test_prefault);
+    RUN_TEST(test_malloc_backing);
+    RUN_TEST(test_regions);
+    RUN_TEST(test_remap);
+    RUN_TEST(test_remap_anon);
+    RUN_TEST(test_select);
+    return UNITY_END();
+}
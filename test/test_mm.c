@@ -1,13 +1,17 @@
+#define _POSIX_C_SOURCE 200809L  // before unity.h includes libc headers (see mm.c)
+
 #include "unity.h"
 #include "memlib.h"
 
 #include "mm.c"
 #include <stdlib.h>
+#include <sys/mman.h>  // shm_unlink
+#include <sys/wait.h>  // waitpid
 
 static BlockHeader *new_block(int size) {
-    // NOTE: here we are allocating blocks with malloc, but
-    // mm.c should allocate them on the heap that you're managing
-    return malloc(size);
+    // NOTE: blocks must be on the heap after `heap_blocks`, since free-list
+    // links are stored as offsets from `heap_blocks`
+    return (BlockHeader *)mem_sbrk(size);
 }
 
 void setUp(void) {
@@ -286,9 +290,829 @@ void test_malloc_realloc_free(void) {
     mm_free(p2);
 }
 
+void test_malloc_regions(void) {
+    MemConfig small = {MEM_BACKING_ANON, 4096, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&small);
+    mem_init();
+    mm_init();
+
+    char *p1 = mm_malloc(3000);
+    TEST_ASSERT(p1 != NULL);
+
+    // does not fit below the limit: served from a new region, within reach
+    // of the 32-bit list links
+    char *p2 = mm_malloc(8000);
+    TEST_ASSERT(p2 != NULL);
+    TEST_ASSERT(p2 < mem_heap_lo() || p2 > mem_heap_hi());
+    BlockHeader *first = (BlockHeader *)(p2 - 4);
+    while (mm_block_size(first - 1) != 8)  // back to the prologue footer
+        first = mm_block_prev(first);
+    BlockHeader *region = first - 2;  // prologue
+    TEST_ASSERT(labs(p2 - (char *)heap_blocks) < INT_MAX);
+    memset(p2, 0x02, 8000);
+
+    // the free block of the region does not coalesce with other regions
+    mm_free(p2);
+    BlockHeader *bp = region + 2;
+    TEST_ASSERT(!mm_block_allocated(bp));
+    TEST_ASSERT(mm_block_size(bp) == REGION_SIZE - REGION_OVERHEAD);
+    TEST_ASSERT(mm_block_allocated(mm_block_next(bp)));
+    TEST_ASSERT(mm_block_size(mm_block_next(bp)) == 0);
+
+    // next allocations reuse it
+    TEST_ASSERT(mm_malloc(8000) == p2);
+    mm_free(p1);
+    mm_free(p2);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_realloc_remap(void) {
+    MemConfig memfd = {MEM_BACKING_MEMFD, 0, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&memfd);
+    mem_init();
+    mm_init();
+
+    int size = 2 * REMAP_THRESHOLD;
+    unsigned char *p1 = mm_malloc(size);
+    char *guard = mm_malloc(100);  // above p1, so that it cannot grow in place
+    for (int i = 0; i < size; i++)
+        p1[i] = i % 251;
+
+    unsigned char *p2 = mm_realloc(p1, size + 10000);
+    TEST_ASSERT(p2 != NULL && p2 != p1);
+    TEST_ASSERT(((uintptr_t)p2 - (uintptr_t)p1) % sysconf(_SC_PAGESIZE) == 0);
+    for (int i = 0; i < size; i++)
+        TEST_ASSERT(p2[i] == i % 251);
+    TEST_ASSERT(mm_block_size((BlockHeader *)(p2 - 4)) == required_block_size(size + 10000));
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(size + 10000) + required_block_size(100));
+
+    mm_free(p2);
+    mm_free(guard);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_attach(void) {
+    char *path = "test/test_mm_heap.tmp";
+    unlink(path);
+    mem_deinit();
+
+    TEST_ASSERT(mm_attach(path) == 0);
+    TEST_ASSERT(mm_get_root() == NULL);
+    char *p1 = mm_malloc(100);
+    strcpy(p1, "persistent");
+    mm_set_root(p1);
+    char *p2 = mm_malloc(5000);
+    int p2_offset = p2 - (char *)heap_blocks;
+    mm_free(p2);
+    long allocated = mm_allocated_bytes();
+    mm_detach();
+
+    // take the address range of the heap, so that it is mapped elsewhere
+    void *other = malloc(40 << 20);
+    TEST_ASSERT(mm_attach(path) == 0);
+    char *root = mm_get_root();
+    TEST_ASSERT(root != NULL);
+    TEST_ASSERT(strcmp(root, "persistent") == 0);
+    TEST_ASSERT(mm_allocated_bytes() == allocated);
+
+    // the free list is back: the freed block is found again
+    p2 = mm_malloc(5000);
+    TEST_ASSERT(p2 - (char *)heap_blocks == p2_offset);
+    mm_free(p2);
+    mm_free(root);
+    mm_set_root(NULL);
+    mm_detach();
+    free(other);
+    unlink(path);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_attach_after_site_heaps(void) {
+    char *path = "test/test_mm_heap.tmp";
+    unlink(path);
+    mm_set_site_heaps(2);
+    mm_init();
+    mm_set_site_heaps(0);
+    TEST_ASSERT(site_heaps_len == 2);
+    mem_deinit();
+
+    // call-site mode ends: blocks come from the attached heap
+    TEST_ASSERT(mm_attach(path) == 0);
+    TEST_ASSERT(site_heaps_len == 0);
+    char *p = mm_malloc(100);
+    TEST_ASSERT(p - (char *)heap_blocks > 0 && mem_contains(p, p + 99));
+    mm_free(p);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+    mm_detach();
+    unlink(path);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_attach_after_short_heap(void) {
+    char *path = "test/test_mm_heap.tmp";
+    unlink(path);
+    mm_init();
+    mm_free(mm_malloc_hint(100, MM_SHORT_LIVED));
+    TEST_ASSERT(short_heap != NULL);
+    mem_deinit();
+
+    // the short-lived heap is released, and not used while attached
+    TEST_ASSERT(mm_attach(path) == 0);
+    TEST_ASSERT(short_heap == NULL);
+    char *p = mm_malloc_hint(100, MM_SHORT_LIVED);
+    TEST_ASSERT(short_heap == NULL && mem_contains(p, p + 99));
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(100));
+    mm_free(p);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+    mm_detach();
+    unlink(path);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_attach_compact(void) {
+    char *path = "test/test_mm_heap.tmp";
+    unlink(path);
+    mem_deinit();
+
+    // no movable blocks: the handle table is not in the file
+    TEST_ASSERT(mm_attach(path) == 0);
+    TEST_ASSERT(mm_halloc(100) == 0);
+    char *p1 = mm_malloc(100);
+    strcpy(p1, "persistent");
+    mm_set_root(p1);
+    mm_free(mm_malloc(100));
+    TEST_ASSERT(mm_compact(1) == 0);  // stopped in the middle of the heap
+    mm_detach();
+
+    // mapped elsewhere: the compactor starts over instead of resuming
+    void *other = malloc(40 << 20);
+    TEST_ASSERT(mm_attach(path) == 0);
+    TEST_ASSERT(compact_cursor == NULL);
+    while (!mm_compact(1000))
+        ;
+    char *root = mm_get_root();
+    TEST_ASSERT(strcmp(root, "persistent") == 0);
+    TEST_ASSERT(mm_halloc(100) == 0);
+    mm_free(root);
+    mm_set_root(NULL);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+    mm_detach();
+    free(other);
+    unlink(path);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_attach_shared(void) {
+    char *name = "/test_mm_shared";
+    shm_unlink(name);
+    mem_deinit();
+
+    TEST_ASSERT(mm_attach_shared(name) == 0);
+    char *request = mm_malloc(1000);
+    strcpy(request, "request");
+    long request_offset = mm_offset(request);
+
+    int fds[2];
+    TEST_ASSERT(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        // map the heap again, elsewhere, then free the request and reply
+        mm_detach();
+        void *other = malloc(40 << 20);
+        if (other == NULL || mm_attach_shared(name) < 0)
+            _exit(1);
+        char *received = mm_pointer(request_offset);
+        if (strcmp(received, "request") != 0)
+            _exit(2);
+        mm_free(received);
+        char *reply = mm_malloc(200000);  // grows the heap
+        strcpy(reply, "reply");
+        long reply_offset = mm_offset(reply);
+        if (write(fds[1], &reply_offset, sizeof(reply_offset)) != sizeof(reply_offset))
+            _exit(3);
+        mm_detach();
+        _exit(0);
+    }
+
+    long reply_offset;
+    int status;
+    TEST_ASSERT(read(fds[0], &reply_offset, sizeof(reply_offset)) == sizeof(reply_offset));
+    TEST_ASSERT(waitpid(pid, &status, 0) == pid);
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    char *reply = mm_pointer(reply_offset);
+    TEST_ASSERT(strcmp(reply, "reply") == 0);
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(200000));
+    mm_free(reply);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+
+    // the request freed by the child was coalesced: a single free block is left
+    TEST_ASSERT(mm_list_headp == heap_blocks + 2);
+    TEST_ASSERT(mm_list_tailp == mm_list_headp);
+
+    // other processes' handles are not in our table: no compaction
+    TEST_ASSERT(mm_compact(1000) == -1);
+
+    mm_detach();
+    shm_unlink(name);
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_init_after_attach_shared(void) {
+    char *name = "/test_mm_shared_init";
+    shm_unlink(name);
+    mem_deinit();
+
+    // the index is private: a shared heap falls back to first fit while attached
+    mm_set_fit_policy(MM_INDEX_FIT);
+    TEST_ASSERT(mm_attach_shared(name) == 0);
+    TEST_ASSERT(fit_policy == MM_FIRST_FIT);
+
+    // mm_init starts a private heap in the same range, without the lock
+    TEST_ASSERT(mm_init() == 0);
+    TEST_ASSERT(!shared && fit_policy == MM_INDEX_FIT);
+    char *p = mm_malloc(100);
+    TEST_ASSERT_NOT_NULL(p);
+    mm_free(p);
+
+    mem_deinit();
+    shm_unlink(name);
+    mm_set_fit_policy(MM_FIRST_FIT);
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_realloc_relocate(void) {
+    mm_init();
+    char *low = mm_malloc(1000);
+    char *guard = mm_malloc(16);
+    char *p = mm_malloc(2000);
+    char *top = mm_malloc(16);
+    memset(p, 0x03, 100);
+    mm_free(low);
+
+    // most of the heap is free: shrinking moves the block down
+    char *q = mm_realloc(p, 100);
+    TEST_ASSERT(q < p);
+    for (int i = 0; i < 100; i++)
+        TEST_ASSERT(q[i] == 0x03);
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(100) + 2 * required_block_size(16));
+
+    // no free block below it: stays in place
+    TEST_ASSERT(mm_realloc(q, 50) == q);
+    mm_free(q);
+    mm_free(guard);
+    mm_free(top);
+
+    // the smallest free block below that fits, not the lowest
+    mm_init();
+    char *large = mm_malloc(3000);
+    char *guard1 = mm_malloc(100);
+    char *small = mm_malloc(200);
+    char *guard2 = mm_malloc(100);
+    p = mm_malloc(4000);
+    TEST_ASSERT(large < small && small < p);
+    mm_free(large);
+    mm_free(small);
+    TEST_ASSERT(mm_realloc(p, 150) == small);
+    mm_free(small);
+    mm_free(guard1);
+    mm_free(guard2);
+}
+
+void test_realloc_grow_top(void) {
+    mm_init();
+    char *p = mm_malloc(100);
+    char *guard = mm_malloc(100);
+    memset(p, 0x04, 100);
+
+    // first growth: moved like any block, and marked as grown
+    p = mm_realloc(p, 600);
+    BlockHeader *bp = (BlockHeader *)(p - 4);
+    TEST_ASSERT(mm_block_grown(bp));
+
+    // second growth with a block above it: moved to the top of the heap
+    char *above = mm_malloc(600);
+    TEST_ASSERT(above > p && !block_at_top(bp));
+    p = mm_realloc(p, 2000);
+    bp = (BlockHeader *)(p - 4);
+    TEST_ASSERT(p > above && block_at_top(bp));
+
+    // next growths extend the heap in place
+    char *q = mm_realloc(p, 20000);
+    TEST_ASSERT(q == p);
+    for (int i = 0; i < 100; i++)
+        TEST_ASSERT(q[i] == 0x04);
+    TEST_ASSERT(mm_block_grown(bp));
+    mm_free(q);
+    mm_free(above);
+    mm_free(guard);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_heaps(void) {
+    mm_init();
+    char *p = mm_malloc(100);
+    long base = mm_allocated_bytes();
+
+    MmHeap *h1 = mm_heap_create();
+    MmHeap *h2 = mm_heap_create();
+    char *a = mm_heap_malloc(h1, 1000);
+    char *b = mm_heap_malloc(h2, 1000);
+    TEST_ASSERT(a != NULL && b != NULL);
+    memset(a, 0x0a, 1000);
+    memset(b, 0x0b, 1000);
+
+    // each heap has its own memory and counters; the default one is untouched
+    TEST_ASSERT(!mem_contains(a, a + 999));
+    TEST_ASSERT(h1->allocated_bytes == required_block_size(1000));
+    TEST_ASSERT(mm_allocated_bytes() == base);
+    TEST_ASSERT(heap_current == &heap_default);
+    TEST_ASSERT(mm_malloc(100) != NULL);
+
+    a = mm_heap_realloc(h1, a, 5000);
+    TEST_ASSERT(a[999] == 0x0a && b[999] == 0x0b);
+    mm_heap_free(h2, b);
+    TEST_ASSERT(mm_heap_malloc(h2, 1000) == b);
+
+    // destroying a heap releases its blocks at once
+    mm_heap_destroy(h1);
+    mm_heap_destroy(h2);
+    TEST_ASSERT(mm_allocated_bytes() == base + required_block_size(100));
+    mm_free(p);
+}
+
+void test_size_cache(void) {
+    mm_set_size_cache(1);
+    mm_init();
+    mm_set_size_cache(0);
+    char *a = mm_malloc(40);  // 48-byte blocks
+    char *b = mm_malloc(40);
+    char *c = mm_malloc(40);
+    char *guard = mm_malloc(40);
+    mm_free(a);
+    mm_free(c);
+
+    // exact fit from the cache: the last block freed with that size
+    TEST_ASSERT(mm_cache_find(48) == (BlockHeader *)(c - 4));
+    TEST_ASSERT(mm_malloc(40) == c);
+    TEST_ASSERT(mm_cache_find(48) == (BlockHeader *)(a - 4));
+
+    // a cached block merged with its neighbor leaves the cache
+    mm_free(b);
+    TEST_ASSERT(mm_cache_find(48) == NULL);
+    TEST_ASSERT(mm_cache_find(96) == (BlockHeader *)(a - 4));
+    TEST_ASSERT(mm_malloc(88) == a);
+    mm_free(guard);
+}
+
+void test_stack_path(void) {
+    mm_init();
+    char *p[5];
+    for (int i = 0; i < 5; i++)
+        p[i] = mm_malloc(16);  // 24-byte blocks
+
+    // frees in stack order start the stack path on the freed block
+    for (int i = 4; i > 1; i--)
+        mm_free(p[i]);
+    TEST_ASSERT(stack.top == NULL);
+    mm_free(p[1]);
+    TEST_ASSERT(stack.top == (BlockHeader *)(p[1] - 4));
+    int top_size = mm_block_size(stack.top);
+
+    // pushes carve at its front, pops merge back into it
+    char *a = mm_malloc(16);
+    char *b = mm_malloc(16);
+    TEST_ASSERT(a == p[1] && b == p[2]);
+    TEST_ASSERT(stack.top == (BlockHeader *)(p[3] - 4));
+    mm_free(b);
+    mm_free(a);
+    TEST_ASSERT(stack.top == (BlockHeader *)(p[1] - 4));
+    TEST_ASSERT(mm_block_size(stack.top) == top_size);
+    TEST_ASSERT(mm_allocated_bytes() == 24);
+
+    // any other operation puts it back on the free list
+    p[0] = mm_realloc(p[0], 32);
+    TEST_ASSERT(stack.top == NULL);
+    mm_free(p[0]);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_stack_path_heaps(void) {
+    mm_init();
+    MmHeap *heap = mm_heap_create();
+    char *p[5], *q[5];
+    for (int i = 0; i < 5; i++)
+        p[i] = mm_malloc(16);
+    for (int i = 0; i < 5; i++)
+        q[i] = mm_heap_malloc(heap, 16);
+
+    // runs on two heaps, interleaved: each heap counts its own
+    for (int i = 4; i > 0; i--) {
+        mm_free(p[i]);
+        mm_heap_free(heap, q[i]);
+    }
+    TEST_ASSERT(stack.top == (BlockHeader *)(p[1] - 4));
+    TEST_ASSERT(heap->stack.top == (BlockHeader *)(q[1] - 4));
+
+    // each stack top survives work on the other heap
+    char *a = mm_malloc(16);
+    char *b = mm_heap_malloc(heap, 16);
+    TEST_ASSERT(a == p[1] && b == q[1]);
+    mm_heap_free(heap, b);
+    mm_free(a);
+    TEST_ASSERT(stack.top == (BlockHeader *)(p[1] - 4));
+    TEST_ASSERT(heap->stack.top == (BlockHeader *)(q[1] - 4));
+
+    mm_heap_free(heap, q[0]);
+    mm_heap_destroy(heap);
+    mm_free(p[0]);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_two_ended(void) {
+    mm_set_two_ended(1000);
+    mm_init();
+    mm_set_two_ended(0);
+
+    // large blocks at the top of the range, the others at the bottom
+    char *small = mm_malloc(100);
+    char *big = mm_malloc(2000);
+    TEST_ASSERT(!block_in_top((BlockHeader *)(small - 4)));
+    TEST_ASSERT(block_in_top((BlockHeader *)(big - 4)));
+    TEST_ASSERT(big > small + (1 << 20));
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(100) + required_block_size(2000));
+    mm_free(big);
+    TEST_ASSERT(mm_malloc(2000) == big);
+
+    // a large block that grows moves to the bottom
+    char *moved = mm_realloc(big, 3000);
+    TEST_ASSERT(!block_in_top((BlockHeader *)(moved - 4)));
+    mm_free(moved);
+
+    // when the areas meet, the free end of the one goes to the other
+    char *huge = mm_realloc(mm_malloc(8), mem_brk_avail() - (1 << 20));
+    TEST_ASSERT(!block_in_top((BlockHeader *)(huge - 4)));
+    mm_free(huge);
+    char *top_huge = mm_malloc(2 << 20);
+    TEST_ASSERT(block_in_top((BlockHeader *)(top_huge - 4)));
+    mm_free(top_huge);
+    char *old_top_lo = top_lo;
+    huge = mm_realloc(mm_malloc(8), mem_brk_avail() + (1 << 20));
+    TEST_ASSERT(top_lo > old_top_lo);
+    TEST_ASSERT(!block_in_top((BlockHeader *)(huge - 4)));
+    mm_free(huge);
+    mm_free(small);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_malloc_hint(void) {
+    mm_init();
+    char *a = mm_malloc(200);
+    char *b = mm_malloc(200);
+    char *top = mm_malloc(200);
+    mm_free(a);
+    mm_free(b);
+
+    // long-lived: at the front of the lowest free block
+    char *keep = mm_malloc_hint(100, MM_LONG_LIVED);
+    TEST_ASSERT(keep < a && keep < b);
+    TEST_ASSERT(lowest_fit(8, (BlockHeader *)(keep - 4)) == NULL);
+
+    // short-lived: on a heap of its own, then freed and resized as usual
+    char *tmp = mm_malloc_hint(100, MM_SHORT_LIVED);
+    char *first = tmp;
+    TEST_ASSERT(short_heap != NULL && !mem_contains(tmp, tmp + 99));
+    TEST_ASSERT(mm_allocated_bytes() == 2 * required_block_size(100) + required_block_size(200));
+    memset(tmp, 0x5a, 100);
+    tmp = mm_realloc(tmp, 3000);
+    TEST_ASSERT(tmp[99] == 0x5a && heap_holds(short_heap, tmp));
+    char *tmp2 = mm_malloc_hint(100, MM_SHORT_LIVED);
+    mm_free(tmp);
+    mm_free(tmp2);
+
+    // once empty, the short-lived heap starts over
+    TEST_ASSERT(short_heap->allocated_bytes == 0);
+    TEST_ASSERT(mm_heapsize() - mem_heapsize() < 1024);
+    TEST_ASSERT(mm_malloc_hint(100, MM_SHORT_LIVED) == first);
+
+    // no hint: as mm_malloc
+    TEST_ASSERT(mm_malloc_hint(100, 0) != NULL);
+    mm_free(keep);
+    mm_free(top);
+    mm_init();
+    TEST_ASSERT(short_heap == NULL);
+}
+
+__attribute__((noinline)) static void *temp_site(size_t size) {
+    return mm_malloc(size);
+}
+
+__attribute__((noinline)) static void *keep_site(size_t size) {
+    return mm_malloc(size);
+}
+
+void test_site_heaps(void) {
+    mm_set_site_heaps(2);
+    mm_init();
+    TEST_ASSERT(site_heaps_len == 2);
+
+    // objects freed at once: the site moves to heap 0 (the default heap)
+    for (int i = 0; i < SITE_ADAPT; i++)
+        mm_free(temp_site(32));
+    char *p = temp_site(32);
+    TEST_ASSERT(mem_contains(p, p));
+
+    // objects that stay live: the site moves to the last heap
+    void *kept[SITE_ADAPT + 1];
+    for (int i = 0; i < SITE_ADAPT; i++)
+        kept[i] = keep_site(32);
+    kept[SITE_ADAPT] = keep_site(32);
+    TEST_ASSERT(!mem_contains(kept[SITE_ADAPT], kept[SITE_ADAPT]));
+    TEST_ASSERT(site_heap_of(kept[SITE_ADAPT]) == site_heaps[1]);
+
+    // blocks keep their site through realloc, and are freed from their heap
+    MmHeap *heap = site_heap_of(kept[0]);
+    kept[0] = mm_realloc(kept[0], 1000);
+    TEST_ASSERT(site_heap_of(kept[0]) == heap);
+    for (int i = 0; i <= SITE_ADAPT; i++)
+        mm_free(kept[i]);
+    mm_free(p);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+    TEST_ASSERT(mm_heapsize() > mem_heapsize());
+
+    mm_set_site_heaps(0);
+    mm_init();
+    TEST_ASSERT(site_heaps_len == 0);
+}
+
+void test_handles_compact(void) {
+    mm_init();
+    char *pinned = mm_malloc(100);  // never moves: below the handles
+    memset(pinned, 0x7f, 100);
+    MmHandle handles[16];
+    for (int i = 0; i < 16; i++) {
+        handles[i] = mm_halloc(1000);
+        TEST_ASSERT(handles[i] != 0);
+        memset(mm_hderef(handles[i]), i, 1000);
+    }
+    for (int i = 0; i < 16; i += 2)
+        mm_hfree(handles[i]);
+    long heap_size = mem_heapsize();
+
+    // a small budget moves at most one block per call
+    TEST_ASSERT(mm_compact(1) == 0);
+    int calls = 1;
+    while (!mm_compact(1000))
+        calls++;
+    TEST_ASSERT(calls > 2);
+
+    for (int i = 1; i < 16; i += 2) {
+        unsigned char *p = mm_hderef(handles[i]);
+        TEST_ASSERT(p[0] == i && p[999] == i);
+    }
+    TEST_ASSERT(pinned[0] == 0x7f && pinned[99] == 0x7f);
+    TEST_ASSERT(mem_heapsize() < heap_size);
+
+    // released handles are reused
+    MmHandle h = mm_halloc(10);
+    TEST_ASSERT(h == handles[14]);
+    mm_hfree(h);
+    for (int i = 1; i < 16; i += 2)
+        mm_hfree(handles[i]);
+    mm_free(pinned);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_tiny(void) {
+    mm_set_tiny(1);
+    mm_init();
+    mm_set_tiny(0);
+    char *a = mm_malloc(1);
+    char *b = mm_malloc(8);
+    char *other = mm_malloc(9);
+    TEST_ASSERT(b == a + 8);  // cells of the same container
+    TEST_ASSERT(mm_tiny_page_of(other) == NULL);
+    TEST_ASSERT(mm_allocated_bytes() == 2 * 8 + required_block_size(9));
+
+    // a cell that grows moves to a block, its 8 bytes are copied
+    memset(b, 0x05, 8);
+    char *c = mm_realloc(b, 100);
+    TEST_ASSERT(mm_tiny_page_of(c) == NULL);
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT(c[i] == 0x05);
+    TEST_ASSERT(mm_realloc(a, 4) == a);
+
+    // a container beyond the first is given back once empty
+    char *cells[1024];
+    for (int i = 0; i < 1024; i++)
+        cells[i] = mm_malloc(8);
+    long heap_size = mm_heapsize();
+    TEST_ASSERT(mm_tiny_page_of(cells[0]) != mm_tiny_page_of(cells[1023]));
+    for (int i = 0; i < 1024; i++)
+        mm_free(cells[i]);
+    mm_free(a);
+    mm_free(c);
+    mm_free(other);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+    TEST_ASSERT(mm_list_headp != NULL && mm_block_size(mm_list_headp) >= 4096);
+    TEST_ASSERT(mm_heapsize() == heap_size);
+}
+
+void test_tiny_limits(void) {
+    // past a limit above the default 40 MB
+    MemConfig large = {MEM_BACKING_ANON, 64 << 20, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&large);
+    mem_init();
+    mm_set_tiny(1);
+    mm_init();
+    char *big = mm_malloc(48 << 20);
+    char *a = mm_malloc(8);
+    TEST_ASSERT(big != NULL && a > big);
+    TEST_ASSERT(mm_tiny_page_of(a) != NULL);
+    mm_free(a);
+    mm_free(big);
+
+    // in an extra region, below the memlib range
+    MemConfig small = {MEM_BACKING_ANON, 4096, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&small);
+    mem_init();
+    mm_init();
+    mm_set_tiny(0);
+    char *p1 = mm_malloc(3000);
+    char *b = mm_malloc(8);
+    TEST_ASSERT(b < mem_heap_lo());
+    TEST_ASSERT(mm_tiny_page_of(b) != NULL);
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(3000) + 8);
+    mm_free(b);
+    mm_free(p1);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_bitmap(void) {
+    mm_set_bitmap(1);
+    mm_init();
+    mm_set_bitmap(0);
+
+    // no footer: 12 bytes of payload fit in 16-byte blocks
+    char *a = mm_malloc(12);
+    char *b = mm_malloc(12);
+    char *c = mm_malloc(12);
+    TEST_ASSERT(b == a + 16 && c == b + 16);
+    TEST_ASSERT(required_block_size(2) == 16);  // not 8: a free block needs its links
+    memset(a, 0x0a, 12);
+    memset(b, 0x0b, 12);
+    memset(c, 0x0c, 12);
+    TEST_ASSERT(mm_bitmap_allocated((BlockHeader *)(b - 4)) == 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated((BlockHeader *)(b - 4)) == 1);
+
+    // frees coalesce from the bitmap, free blocks keep a footer
+    mm_free(a);
+    mm_free(c);
+    TEST_ASSERT(b[11] == 0x0b);
+    TEST_ASSERT(mm_bitmap_prev_allocated((BlockHeader *)(b - 4)) == 0);
+    mm_free(b);
+    TEST_ASSERT(mm_list_headp == (BlockHeader *)(a - 4));
+    TEST_ASSERT(mm_list_tailp == mm_list_headp);
+
+    // a block moved by realloc keeps its last payload bytes
+    char *p = mm_malloc(20);
+    char *guard = mm_malloc(12);
+    memset(p, 0x0d, 20);
+    char *q = mm_realloc(p, 200);
+    TEST_ASSERT(q != p);
+    for (int i = 0; i < 20; i++)
+        TEST_ASSERT(q[i] == 0x0d);
+    mm_free(q);
+    mm_free(guard);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_bitmap_regions(void) {
+    MemConfig small = {MEM_BACKING_ANON, 4096, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&small);
+    mem_init();
+    mm_set_bitmap(1);
+    mm_init();
+    mm_set_bitmap(0);
+    TEST_ASSERT(bitmap_on);
+
+    // past the limit, blocks go to regions with a bitmap of their own
+    char *p1 = mm_malloc(3000);
+    char *p2 = mm_malloc(8000);
+    char *p3 = mm_malloc(2000);
+    TEST_ASSERT(p1 != NULL && p2 != NULL && p3 != NULL);
+    TEST_ASSERT(p2 < mem_heap_lo() || p2 > mem_heap_hi());
+    TEST_ASSERT(labs(p3 - p2) < REGION_SIZE);  // in the same region
+    memset(p2, 0x02, 8000);
+    memset(p3, 0x03, 2000);
+    BlockHeader *first = (BlockHeader *)(MIN(p2, p3) - 4);
+    while (!block_prev_allocated(first))  // back to the first block of the region
+        first = mm_block_prev(first);
+    TEST_ASSERT(mm_bitmap_allocated((BlockHeader *)(p2 - 4)) == 1);
+    TEST_ASSERT(mm_bitmap_allocated((BlockHeader *)(p3 - 4)) == 1);
+
+    // frees coalesce within the region from its bitmap
+    mm_free(p2);
+    TEST_ASSERT(mm_bitmap_allocated((BlockHeader *)(p2 - 4)) == 0);
+    TEST_ASSERT(p3[1999] == 0x03);
+    mm_free(p3);
+    TEST_ASSERT(!mm_block_allocated(first));
+    TEST_ASSERT(mm_block_size(first) == REGION_SIZE - REGION_OVERHEAD);
+    TEST_ASSERT(mm_bitmap_allocated(mm_block_next(first)) == 1);  // epilogue
+    TEST_ASSERT(mm_malloc(8000) == p2);
+    mm_free(p2);
+    mm_free(p1);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+
+    MemConfig defaults = {MEM_BACKING_ANON, 0, 0, 0, NULL};
+    mem_deinit();
+    mem_configure(&defaults);
+    mem_init();
+}
+
+void test_spans(void) {
+    mem_reset_brk();  // the whole range, for the heaps to meet
+    mm_set_spans(16384);
+    mm_init();
+    mm_set_spans(0);
+
+    // large blocks are spans of whole pages, the others blocks at the bottom
+    char *small = mm_malloc(100);
+    char *big = mm_malloc(20000);
+    TEST_ASSERT(!mm_span_owns(small));
+    TEST_ASSERT(mm_span_owns(big));
+    TEST_ASSERT((uintptr_t)big % SPAN_PAGE == 0);
+    TEST_ASSERT(mm_allocated_bytes() == required_block_size(100) + 5 * SPAN_PAGE);
+    mm_free(big);
+    TEST_ASSERT(mm_malloc(20000) == big);
+
+    // a span grows into the free pages after it, else moves
+    memset(big, 0x0b, 20000);
+    char *above = mm_malloc(16384);
+    TEST_ASSERT(mm_realloc(big, 20480) == big);
+    char *moved = mm_realloc(big, 30000);
+    TEST_ASSERT(moved != big && mm_span_owns(moved));
+    for (int i = 0; i < 20000; i++)
+        TEST_ASSERT(moved[i] == 0x0b);
+    mm_free(above);
+    mm_free(moved);
+
+    // when the heaps meet, the free pages at the bottom of the page heap go
+    // to the default heap, and the free end of the default heap to the pages
+    char *huge = mm_malloc(mem_brk_avail() - (1 << 20));
+    TEST_ASSERT(mm_span_owns(huge));
+    mm_free(huge);
+    huge = mm_malloc_hint(mem_brk_avail() + (1 << 20), MM_LONG_LIVED);
+    TEST_ASSERT(huge != NULL && !mm_span_owns(huge));
+    mm_free(huge);
+    huge = mm_malloc(mem_brk_avail() + (1 << 20));
+    TEST_ASSERT(huge != NULL && mm_span_owns(huge));
+    mm_free(huge);
+    mm_free(small);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
 int main(void) {
     UNITY_BEGIN();
     mem_init();
+    heap_blocks = (BlockHeader *)mem_sbrk(8);  // offset 0 is the NULL link
     RUN_TEST(test_free_coalesce_alloc_alloc);
     RUN_TEST(test_free_coalesce_alloc_free);
     RUN_TEST(test_free_coalesce_free_alloc);
@@ -299,6 +1123,29 @@ int main(void) {
     RUN_TEST(test_place_large_leftover);
     RUN_TEST(test_malloc_free);
     RUN_TEST(test_malloc_realloc_free);
+    RUN_TEST(test_malloc_regions);
+    RUN_TEST(test_realloc_remap);
+    RUN_TEST(test_realloc_relocate);
+    RUN_TEST(test_realloc_grow_top);
+    RUN_TEST(test_attach);
+    RUN_TEST(test_attach_after_site_heaps);
+    RUN_TEST(test_attach_after_short_heap);
+    RUN_TEST(test_attach_compact);
+    RUN_TEST(test_attach_shared);
+    RUN_TEST(test_init_after_attach_shared);
+    RUN_TEST(test_handles_compact);
+    RUN_TEST(test_heaps);
+    RUN_TEST(test_site_heaps);
+    RUN_TEST(test_malloc_hint);
+    RUN_TEST(test_size_cache);
+    RUN_TEST(test_stack_path);
+    RUN_TEST(test_stack_path_heaps);
+    RUN_TEST(test_two_ended);
+    RUN_TEST(test_tiny);
+    RUN_TEST(test_tiny_limits);
+    RUN_TEST(test_bitmap);
+    RUN_TEST(test_bitmap_regions);
+    RUN_TEST(test_spans);
     mem_deinit();
     return UNITY_END();
 }
@@ -0,0 +1,92 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm_arena.c"
+#include <stdint.h>  // uintptr_t
+
+void setUp(void) {
+    mem_reset_brk();
+    mm_init();
+}
+
+void tearDown(void) {
+
+}
+
+static int chunk_count(MmArena *arena) {
+    int count = 0;
+    for (ArenaChunk *chunk = arena->chunks; chunk != NULL; chunk = chunk->next)
+        count++;
+    return count;
+}
+
+void test_alloc_bumps(void) {
+    MmArena *arena = mm_arena_create(256);
+    long base = mm_allocated_bytes();
+
+    char *p1 = mm_arena_alloc(arena, 10);
+    char *p2 = mm_arena_alloc(arena, 8);
+    char *p3 = mm_arena_alloc(arena, 1);
+    TEST_ASSERT((uintptr_t)p1 % 8 == 0);
+    TEST_ASSERT(p2 == p1 + 16);  // no header between objects
+    TEST_ASSERT(p3 == p2 + 8);
+    TEST_ASSERT(chunk_count(arena) == 1);
+    TEST_ASSERT(mm_allocated_bytes() > base);
+    TEST_ASSERT(mm_arena_alloc(arena, 0) == NULL);
+
+    // the current chunk is full: a new one is taken
+    for (int i = 0; i < 30; i++)
+        mm_arena_alloc(arena, 8);
+    TEST_ASSERT(chunk_count(arena) == 2);
+
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_large_alloc(void) {
+    MmArena *arena = mm_arena_create(256);
+    char *p1 = mm_arena_alloc(arena, 8);
+    char *big = mm_arena_alloc(arena, 1000);
+    TEST_ASSERT(big != NULL);
+    TEST_ASSERT(chunk_count(arena) == 2);
+
+    // the current chunk is still used after a large allocation
+    TEST_ASSERT(mm_arena_alloc(arena, 8) == p1 + 8);
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_reset(void) {
+    MmArena *arena = mm_arena_create(0);
+    mm_arena_alloc(arena, 100);
+    for (int i = 0; i < 1000; i++)
+        mm_arena_alloc(arena, 24);
+    mm_arena_alloc(arena, 5000);
+    TEST_ASSERT(chunk_count(arena) > 2);
+
+    // only the current chunk is kept, and reused from its start
+    mm_arena_reset(arena);
+    TEST_ASSERT(chunk_count(arena) == 1);
+    char *p = mm_arena_alloc(arena, 100);
+    TEST_ASSERT(p == chunk_data(arena->chunks));
+
+    // nothing but large chunks: all freed
+    MmArena *large = mm_arena_create(64);
+    mm_arena_alloc(large, 1000);
+    mm_arena_reset(large);
+    TEST_ASSERT(chunk_count(large) == 0);
+
+    mm_arena_destroy(large);
+    mm_arena_destroy(arena);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_alloc_bumps);
+    RUN_TEST(test_large_alloc);
+    RUN_TEST(test_reset);
+    mem_deinit();
+    return UNITY_END();
+}
@@ -0,0 +1,110 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm_bitmap.c"
+
+static char *base;
+
+// header of the block at granule `g` (4 bytes before an aligned payload)
+#define BLOCK(g) ((BlockHeader *)(base + 4 + 8 * (g)))
+
+void setUp(void) {
+    mem_reset_brk();
+    base = mem_heap_lo();
+    TEST_ASSERT(mm_bitmap_init(base) == 0);
+}
+
+void tearDown(void) {
+
+}
+
+void test_set(void) {
+    // prologue, a 24-byte block, a 16-byte block, a free block, epilogue
+    mm_bitmap_set(BLOCK(0), 8, 1);
+    mm_bitmap_set(BLOCK(1), 24, 1);
+    mm_bitmap_set(BLOCK(4), 16, 1);
+    mm_bitmap_set(BLOCK(6), 64, 0);
+    mm_bitmap_set(BLOCK(14), 0, 1);
+
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(1)) == 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(1)) == 1);  // the prologue
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(4)) == 1);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(6)) == 0);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(6)) == 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(14)) == 0);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(14)) == 1);
+
+    // freed: both ends cleared; merged with the next block: the last
+    // granule of the merged block is cleared, the rest are never read
+    mm_bitmap_set(BLOCK(4), 80, 0);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(4)) == 0);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(14)) == 0);
+
+    // split again: a 16-byte allocated block at the end
+    mm_bitmap_set(BLOCK(4), 64, 0);
+    mm_bitmap_set(BLOCK(12), 16, 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(12)) == 0);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(14)) == 1);
+
+    // alignment words are not block headers
+    mm_bitmap_set((BlockHeader *)(base + 8 * 14), 0, 0);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(14)) == 1);
+}
+
+void test_cover(void) {
+    long size = mem_heapsize();
+    TEST_ASSERT(size == BITMAP_GROW);
+    TEST_ASSERT(mm_bitmap_cover(base + 4096) == 0);
+    TEST_ASSERT(mem_heapsize() == size);  // one cache line covers 4 KB
+
+    // words across the next cache line
+    TEST_ASSERT(mm_bitmap_cover(base + 4096 + 8) == 0);
+    TEST_ASSERT(mem_heapsize() == size + BITMAP_GROW);
+    mm_bitmap_set(BLOCK(500), 32, 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(504)) == 1);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(504)) == 0);
+
+    // new words are cleared even if the memory was used before
+    mem_reset_brk();
+    memset(mem_sbrk_top(2 * BITMAP_GROW), 0xff, 2 * BITMAP_GROW);
+    mem_reset_brk();
+    TEST_ASSERT(mm_bitmap_init(base) == 0);
+    TEST_ASSERT(mm_bitmap_cover(base + 4096 + 8) == 0);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(504)) == 0);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(1)) == 0);
+}
+
+void test_region(void) {
+    // a region is looked up by address, its words follow its blocks
+    long size = 4096;
+    char *region = mem_region(size + mm_bitmap_bytes(size));
+    TEST_ASSERT(region != (void *)-1);
+    memset(region + size, 0xff, mm_bitmap_bytes(size));
+    TEST_ASSERT(mm_bitmap_add_region(region, size) == 0);
+    BlockHeader *bp = (BlockHeader *)(region + 12);
+    mm_bitmap_set((BlockHeader *)(region + 4), 8, 1);  // prologue
+    mm_bitmap_set(bp, 4080, 0);
+    mm_bitmap_set((BlockHeader *)(region + size - 4), 0, 1);  // epilogue
+    TEST_ASSERT(mm_bitmap_allocated(bp) == 0);
+    TEST_ASSERT(mm_bitmap_prev_allocated(bp) == 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated((BlockHeader *)(region + size - 4)) == 0);
+
+    // the heap bits are unchanged
+    mm_bitmap_set(BLOCK(1), 24, 1);
+    mm_bitmap_set(bp, 24, 1);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(1)) == 1);
+    TEST_ASSERT(mm_bitmap_prev_allocated(BLOCK(4)) == 1);
+    mm_bitmap_set(BLOCK(1), 24, 0);
+    TEST_ASSERT(mm_bitmap_allocated(bp) == 1);
+    TEST_ASSERT(mm_bitmap_allocated(BLOCK(1)) == 0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_set);
+    RUN_TEST(test_cover);
+    RUN_TEST(test_region);
+    mem_deinit();
+    return UNITY_END();
+}
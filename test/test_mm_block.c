@@ -27,6 +27,31 @@ void test_mm_block_header(void) {
     TEST_ASSERT(mm_block_size(bp) == 16);
 }
 
+void test_mm_block_movable(void) {
+    BlockHeader *bp = new_block(16);
+    mm_block_set_header(bp, 16, 1);
+    TEST_ASSERT(mm_block_movable(bp) == 0);
+    mm_block_set_movable(bp);
+    TEST_ASSERT(mm_block_movable(bp) == 1);
+    TEST_ASSERT(mm_block_allocated(bp) == 1);
+    TEST_ASSERT(mm_block_size(bp) == 16);
+    mm_block_set_header(bp, 16, 0);
+    TEST_ASSERT(mm_block_movable(bp) == 0);
+}
+
+void test_mm_block_grown(void) {
+    BlockHeader *bp = new_block(16);
+    mm_block_set_header(bp, 16, 1);
+    mm_block_set_movable(bp);
+    TEST_ASSERT(mm_block_grown(bp) == 0);
+    mm_block_set_grown(bp);
+    TEST_ASSERT(mm_block_grown(bp) == 1);
+    TEST_ASSERT(mm_block_movable(bp) == 1);
+    TEST_ASSERT(mm_block_size(bp) == 16);
+    mm_block_set_header(bp, 16, 1);
+    TEST_ASSERT(mm_block_grown(bp) == 0);
+}
+
 void test_mm_block_footer(void) {
     BlockHeader *bp = new_block(16);
     mm_block_set_header(bp, 16, 1);
@@ -73,6 +98,8 @@ int main(void) {
     UNITY_BEGIN();
     mem_init();
     RUN_TEST(test_mm_block_header);
+    RUN_TEST(test_mm_block_movable);
+    RUN_TEST(test_mm_block_grown);
     RUN_TEST(test_mm_block_footer);
     RUN_TEST(test_mm_block_payload_addr);
     RUN_TEST(test_mm_block_prev_next);
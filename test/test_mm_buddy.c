@@ -0,0 +1,103 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm_buddy.c"
+
+void setUp(void) {
+    mem_reset_brk();
+    mm_buddy_init();
+}
+
+void tearDown(void) {
+
+}
+
+static int free_count(int order) {
+    int count = 0;
+    for (int off = buddy_free[order]; off != BUDDY_NONE; off = buddy_block(off)->next_free)
+        count++;
+    return count;
+}
+
+void test_init(void) {
+    TEST_ASSERT(buddy_order == BUDDY_INIT_ORDER);
+    TEST_ASSERT(buddy_free[BUDDY_INIT_ORDER] == 0);
+    TEST_ASSERT(free_count(BUDDY_INIT_ORDER) == 1);
+    TEST_ASSERT(mm_buddy_allocated_bytes() == 0);
+}
+
+void test_malloc_splits(void) {
+    char *p = mm_buddy_malloc(8);
+    TEST_ASSERT(p == buddy_base + 4);
+    TEST_ASSERT((unsigned long)p % 8 == 0);
+    TEST_ASSERT(buddy_block(0)->header == ((BUDDY_MIN_ORDER << 1) | 1));
+    TEST_ASSERT(mm_buddy_allocated_bytes() == 16);
+
+    // one free upper half for each order below the heap order
+    for (int k = BUDDY_MIN_ORDER; k < BUDDY_INIT_ORDER; k++) {
+        TEST_ASSERT(free_count(k) == 1);
+        TEST_ASSERT(buddy_free[k] == (1 << k));
+    }
+    TEST_ASSERT(free_count(BUDDY_INIT_ORDER) == 0);
+}
+
+void test_free_merges_buddies(void) {
+    char *p1 = mm_buddy_malloc(12);  // 16 bytes at offset 0
+    char *p2 = mm_buddy_malloc(12);  // 16 bytes at offset 16, its buddy
+    TEST_ASSERT(p2 == p1 + 16);
+    TEST_ASSERT(free_count(BUDDY_MIN_ORDER) == 0);
+
+    mm_buddy_free(p2);
+    TEST_ASSERT(free_count(BUDDY_MIN_ORDER) == 1);
+
+    mm_buddy_free(p1);
+    TEST_ASSERT(free_count(BUDDY_INIT_ORDER) == 1);
+    for (int k = BUDDY_MIN_ORDER; k < BUDDY_INIT_ORDER; k++)
+        TEST_ASSERT(free_count(k) == 0);
+    TEST_ASSERT(mm_buddy_allocated_bytes() == 0);
+}
+
+void test_malloc_grows_heap(void) {
+    char *p1 = mm_buddy_malloc(100);
+    char *p2 = mm_buddy_malloc(5000);  // order 13, heap doubles twice
+    TEST_ASSERT(p2 != NULL);
+    TEST_ASSERT(buddy_order == 14);
+    TEST_ASSERT(p2 == buddy_base + (1 << 13) + 4);
+    TEST_ASSERT(mem_heapsize() == 4 + (1 << 14));
+
+    mm_buddy_free(p1);
+    mm_buddy_free(p2);
+    TEST_ASSERT(free_count(14) == 1);
+}
+
+void test_realloc_in_place(void) {
+    char *p = mm_buddy_malloc(8);
+    for (int i = 0; i < 8; i++)
+        p[i] = i;
+
+    // upper buddies are free: grow from 16 to 64 bytes without moving
+    char *q = mm_buddy_realloc(p, 60);
+    TEST_ASSERT(q == p);
+    TEST_ASSERT(buddy_block(0)->header == ((6 << 1) | 1));
+    TEST_ASSERT(mm_buddy_allocated_bytes() == 64);
+
+    // block the next buddy: must move and copy
+    char *r = mm_buddy_malloc(60);
+    TEST_ASSERT(r == p + 64);
+    q = mm_buddy_realloc(p, 100);
+    TEST_ASSERT(q != p);
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT(q[i] == i);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_init);
+    RUN_TEST(test_malloc_splits);
+    RUN_TEST(test_free_merges_buddies);
+    RUN_TEST(test_malloc_grows_heap);
+    RUN_TEST(test_realloc_in_place);
+    mem_deinit();
+    return UNITY_END();
+}
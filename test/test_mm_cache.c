@@ -0,0 +1,86 @@
+#include "unity.h"
+
+#include "mm_cache.c"
+
+static BlockHeader heap[64];  // blocks are only used for their headers
+
+static BlockHeader *new_block(int offset, int size) {
+    BlockHeader *bp = (BlockHeader *)((char *)heap + offset);
+    mm_block_set_header(bp, size, 0);
+    return bp;
+}
+
+void setUp(void) {
+    mm_cache_init();
+}
+
+void tearDown(void) {
+
+}
+
+void test_add_find(void) {
+    TEST_ASSERT(mm_cache_find(16) == NULL);
+
+    BlockHeader *b1 = new_block(8, 16);
+    BlockHeader *b2 = new_block(32, 48);
+    BlockHeader *b3 = new_block(80, 16);
+    mm_cache_add(b1);
+    mm_cache_add(b2);
+    TEST_ASSERT(mm_cache_find(16) == b1);
+    TEST_ASSERT(mm_cache_find(48) == b2);
+    TEST_ASSERT(mm_cache_find(24) == NULL);  // exact sizes only
+
+    // last added, first found
+    mm_cache_add(b3);
+    TEST_ASSERT(mm_cache_find(16) == b3);
+}
+
+void test_remove(void) {
+    BlockHeader *b1 = new_block(8, 16);
+    BlockHeader *b2 = new_block(32, 16);
+    BlockHeader *b3 = new_block(56, 16);
+    mm_cache_add(b1);
+    mm_cache_add(b2);
+    mm_cache_add(b3);
+
+    mm_cache_remove(b2, 16);
+    TEST_ASSERT(mm_cache_find(16) == b3);
+    mm_cache_remove(b3, 16);
+    TEST_ASSERT(mm_cache_find(16) == b1);
+
+    // a block merged into a larger one leaves the stack of its old size
+    mm_block_set_header(b1, 64, 0);
+    mm_cache_remove(b1, 16);
+    mm_cache_add(b1);
+    TEST_ASSERT(mm_cache_find(16) == NULL);
+    TEST_ASSERT(mm_cache_find(64) == b1);
+
+    mm_cache_remove(b2, 16);  // not cached: nothing happens
+    TEST_ASSERT(mm_cache_find(64) == b1);
+}
+
+void test_limits(void) {
+    // large blocks are left to the fit search
+    BlockHeader *big = new_block(8, CACHE_MAX_SIZE + 8);
+    mm_cache_add(big);
+    TEST_ASSERT(mm_cache_find(CACHE_MAX_SIZE + 8) == NULL);
+    mm_cache_remove(big, CACHE_MAX_SIZE + 8);
+
+    // a full stack keeps the blocks it has
+    BlockHeader *first = new_block(0, 16);
+    mm_cache_add(first);
+    for (int i = 1; i < CACHE_DEPTH; i++)
+        mm_cache_add(new_block(0, 16));
+    mm_cache_add(new_block(16, 16));
+    TEST_ASSERT(cache_len[2] == CACHE_DEPTH);
+    TEST_ASSERT(mm_cache_find(16) != (BlockHeader *)((char *)heap + 16));
+    TEST_ASSERT(cache_blocks[2][0] == first);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_add_find);
+    RUN_TEST(test_remove);
+    RUN_TEST(test_limits);
+    return UNITY_END();
+}
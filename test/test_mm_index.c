@@ -0,0 +1,110 @@
+#include "unity.h"
+
+#include "mm_index.c"
+
+static BlockHeader heap[64];  // blocks are only used for their headers
+
+static BlockHeader *new_block(int offset, int size) {
+    BlockHeader *bp = (BlockHeader *)((char *)heap_blocks + offset);
+    mm_block_set_header(bp, size, 0);
+    return bp;
+}
+
+void setUp(void) {
+    heap_blocks = heap;
+    mm_index_init();
+}
+
+void tearDown(void) {
+
+}
+
+static void check_scans(scan_f ge, scan_f eq) {
+    int values[24 + INDEX_PAD] = {0};
+    for (int i = 0; i < 24; i++)
+        values[i] = 8 * i;
+
+    TEST_ASSERT(ge(values, 24, 0) == 0);
+    TEST_ASSERT(ge(values, 24, 9) == 2);
+    TEST_ASSERT(ge(values, 24, 184) == 23);  // last one, in the last vector
+    TEST_ASSERT(ge(values, 24, 185) == -1);
+    TEST_ASSERT(eq(values, 24, 40) == 5);
+    TEST_ASSERT(eq(values, 24, 41) == -1);
+    TEST_ASSERT(eq(values, 3, 16) == 2);
+}
+
+void test_scan_scalar(void) {
+    check_scans(scan_ge_scalar, scan_eq_scalar);
+}
+
+void test_scan_simd(void) {
+#ifdef MM_INDEX_X86
+    if (__builtin_cpu_supports("sse2"))
+        check_scans(scan_ge_sse2, scan_eq_sse2);
+    if (__builtin_cpu_supports("avx2"))
+        check_scans(scan_ge_avx2, scan_eq_avx2);
+#endif
+}
+
+void test_add_find(void) {
+    TEST_ASSERT(mm_index_valid());
+    TEST_ASSERT(mm_index_find(16) == NULL);
+
+    BlockHeader *b1 = new_block(8, 16);
+    BlockHeader *b2 = new_block(32, 48);
+    mm_index_add(b1);
+    mm_index_add(b2);
+    TEST_ASSERT(mm_index_find(16) == b1);
+    TEST_ASSERT(mm_index_find(24) == b2);
+    TEST_ASSERT(mm_index_find(48) == b2);
+    TEST_ASSERT(mm_index_find(56) == NULL);
+}
+
+void test_remove_resize(void) {
+    BlockHeader *b1 = new_block(8, 16);
+    BlockHeader *b2 = new_block(32, 48);
+    BlockHeader *b3 = new_block(96, 24);
+    mm_index_add(b1);
+    mm_index_add(b2);
+    mm_index_add(b3);
+
+    // the last entry fills the hole, the old last slot is a sentinel again
+    mm_index_remove(b1);
+    TEST_ASSERT(index_len == 2);
+    TEST_ASSERT(index_offsets[0] == 96);
+    TEST_ASSERT(index_offsets[2] == -1);
+    TEST_ASSERT(index_sizes[2] == 0);
+    TEST_ASSERT(mm_index_find(16) == b3);
+
+    mm_block_set_header(b3, 64, 0);
+    mm_index_resize(b3);
+    TEST_ASSERT(mm_index_find(56) == b3);
+
+    mm_index_remove(b3);
+    mm_index_remove(b2);
+    TEST_ASSERT(index_len == 0);
+    TEST_ASSERT(mm_index_find(16) == NULL);
+}
+
+void test_overflow(void) {
+    BlockHeader *b1 = new_block(8, 16);
+    for (int i = 0; i < INDEX_CAPACITY; i++)
+        mm_index_add(b1);
+    TEST_ASSERT(mm_index_valid());
+    mm_index_add(b1);
+    TEST_ASSERT(!mm_index_valid());
+
+    mm_index_init();
+    TEST_ASSERT(mm_index_valid());
+    TEST_ASSERT(mm_index_find(16) == NULL);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_scan_scalar);
+    RUN_TEST(test_scan_simd);
+    RUN_TEST(test_add_find);
+    RUN_TEST(test_remove_resize);
+    RUN_TEST(test_overflow);
+    return UNITY_END();
+}
@@ -5,17 +5,20 @@
 #include "mm_list.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 static BlockHeader *new_block() {
-    // NOTE: here we are allocating blocks with malloc, but
-    // mm.c should allocate them on the heap that you're managing
-    BlockHeader *bp = malloc(16);
+    // NOTE: blocks must be on the heap after `heap_blocks`, since list links
+    // are stored as offsets from `heap_blocks`
+    BlockHeader *bp = (BlockHeader *)mem_sbrk(16);
     *(bp+1) = 0x03030303;
     *(bp+2) = 0x04040404;
     return bp;
 }
 
 void setUp(void) {
+    mem_reset_brk();
+    heap_blocks = (BlockHeader *)mem_sbrk(8);  // offset 0 is the NULL link
     mm_list_init();
 }
 
@@ -122,8 +125,37 @@ void test_remove_middle(void) {
     TEST_ASSERT(mm_list_tailp == b3);
 }
 
+void test_links_are_offsets(void) {
+    BlockHeader *b1 = new_block();
+    BlockHeader *b2 = new_block();
+    BlockHeader *b3 = new_block();
+    mm_list_append(b1);
+    mm_list_append(b2);
+    mm_list_append(b3);
+
+    // copy the heap somewhere else: the list is still valid there
+    long size = mem_heapsize();
+    char *copy = malloc(size);
+    memcpy(copy, mem_heap_lo(), size);
+    long head_offset = (char *)mm_list_headp - mem_heap_lo();
+    long tail_offset = (char *)mm_list_tailp - mem_heap_lo();
+    memset(mem_heap_lo(), 0, size);
+
+    heap_blocks = (BlockHeader *)copy;
+    mm_list_headp = (BlockHeader *)(copy + head_offset);
+    mm_list_tailp = (BlockHeader *)(copy + tail_offset);
+    BlockHeader *c2 = mm_list_next(mm_list_headp);
+    TEST_ASSERT((char *)c2 == copy + ((char *)b2 - mem_heap_lo()));
+    TEST_ASSERT(mm_list_next(c2) == mm_list_tailp);
+    TEST_ASSERT(mm_list_prev(mm_list_tailp) == c2);
+    TEST_ASSERT(mm_list_prev(mm_list_headp) == NULL);
+    TEST_ASSERT(mm_list_next(mm_list_tailp) == NULL);
+    free(copy);
+}
+
 int main(void) {
     UNITY_BEGIN();
+    mem_init();
     RUN_TEST(test_append_empty);
     RUN_TEST(test_append_nonempty);
     RUN_TEST(test_prepend_empty);
@@ -132,5 +164,7 @@ int main(void) {
     RUN_TEST(test_remove_head);
     RUN_TEST(test_remove_tail);
     RUN_TEST(test_remove_middle);
+    RUN_TEST(test_links_are_offsets);
+    mem_deinit();
     return UNITY_END();
 }
@@ -0,0 +1,136 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm_pool.c"
+
+void setUp(void) {
+    mem_reset_brk();
+    mm_init();
+}
+
+void tearDown(void) {
+
+}
+
+static int chunk_count(MmPool *pool) {
+    int count = 0;
+    for (PoolChunk *chunk = pool->chunks; chunk != NULL; chunk = chunk->next)
+        count++;
+    return count;
+}
+
+void test_create(void) {
+    MmPool *pool = mm_pool_create(20, 8);
+    TEST_ASSERT(pool->object_size == 24);
+    TEST_ASSERT(pool->chunk_bytes == POOL_CHUNK_BYTES);
+    TEST_ASSERT(pool->per_chunk == (int)((POOL_CHUNK_BYTES - 8 - pool->header) / 24));
+    mm_pool_destroy(pool);
+
+    pool = mm_pool_create(1, 1);
+    TEST_ASSERT(pool->object_size == sizeof(void *));  // room for the link
+    mm_pool_destroy(pool);
+
+    pool = mm_pool_create(5000, 8);
+    TEST_ASSERT(pool->chunk_bytes == 2 * POOL_CHUNK_BYTES);  // one object at least
+    TEST_ASSERT(pool->per_chunk == 1);
+    mm_pool_destroy(pool);
+
+    TEST_ASSERT(mm_pool_create(16, 12) == NULL);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_alloc_free(void) {
+    MmPool *pool = mm_pool_create(48, 64);
+    char *p1 = mm_pool_alloc(pool);
+    char *p2 = mm_pool_alloc(pool);
+    TEST_ASSERT((uintptr_t)p1 % 64 == 0);
+    TEST_ASSERT(p2 == p1 + 64);  // in address order, no header
+    TEST_ASSERT(chunk_count(pool) == 1);
+    TEST_ASSERT(pool->chunks->free_count == pool->per_chunk - 2);
+    TEST_ASSERT((uintptr_t)pool->chunks % pool->chunk_bytes == 0);
+
+    // last freed, first reused
+    mm_pool_free(pool, p1);
+    TEST_ASSERT(mm_pool_alloc(pool) == p1);
+
+    mm_pool_destroy(pool);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_trim(void) {
+    MmPool *pool = mm_pool_create(64, 8);
+    int n = 3 * pool->per_chunk;
+    void *objs[3 * (POOL_CHUNK_BYTES / 64)];
+    for (int i = 0; i < n; i++)
+        objs[i] = mm_pool_alloc(pool);
+    TEST_ASSERT(chunk_count(pool) == 3);
+
+    // one object kept in the first chunk: one empty chunk is kept, the other
+    // goes back to mm at once, then the kept one with an explicit trim
+    for (int i = 1; i < n; i++)
+        mm_pool_free(pool, objs[i]);
+    TEST_ASSERT(chunk_count(pool) == 2);
+    TEST_ASSERT(mm_pool_trim(pool) == 1);
+    TEST_ASSERT(chunk_count(pool) == 1);
+    TEST_ASSERT(pool->chunks->free_count == pool->per_chunk - 1);
+
+    mm_pool_free(pool, objs[0]);
+    TEST_ASSERT(mm_pool_trim(pool) == 1);
+    TEST_ASSERT(chunk_count(pool) == 0);
+    TEST_ASSERT(pool->partial == NULL);
+
+    // the pool still works after giving back all chunks
+    TEST_ASSERT(mm_pool_alloc(pool) != NULL);
+    mm_pool_destroy(pool);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+void test_free_random(void) {
+    // many chunks, freed in random order: each free finds its chunk in O(1)
+    static void *objs[100000];
+    int n = sizeof(objs) / sizeof(objs[0]);
+    MmPool *pool = mm_pool_create(32, 8);
+    for (int i = 0; i < n; i++) {
+        objs[i] = mm_pool_alloc(pool);
+        TEST_ASSERT(objs[i] != NULL);
+    }
+    int chunks = chunk_count(pool);
+    TEST_ASSERT(chunks == (n + pool->per_chunk - 1) / pool->per_chunk);
+
+    unsigned seed = 1;
+    for (int i = n - 1; i > 0; i--) {
+        seed = seed * 1103515245 + 12345;
+        int j = (seed >> 8) % (i + 1);
+        void *tmp = objs[i];
+        objs[i] = objs[j];
+        objs[j] = tmp;
+    }
+    for (int i = 0; i < n / 2; i++)
+        mm_pool_free(pool, objs[i]);
+    TEST_ASSERT(chunk_count(pool) <= chunks);
+    for (int i = n / 2; i < n; i++)
+        mm_pool_free(pool, objs[i]);
+    TEST_ASSERT(chunk_count(pool) == 1);  // the one kept empty
+
+    // the freed objects are reused
+    for (int i = 0; i < n; i++)
+        objs[i] = mm_pool_alloc(pool);
+    TEST_ASSERT(chunk_count(pool) == chunks);
+    for (int i = 0; i < n; i++)
+        mm_pool_free(pool, objs[i]);
+    TEST_ASSERT(mm_pool_trim(pool) == 1);
+    TEST_ASSERT(chunk_count(pool) == 0);
+    mm_pool_destroy(pool);
+    TEST_ASSERT(mm_allocated_bytes() == 0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_create);
+    RUN_TEST(test_alloc_free);
+    RUN_TEST(test_trim);
+    RUN_TEST(test_free_random);
+    mem_deinit();
+    return UNITY_END();
+}
@@ -0,0 +1,118 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "mm_span.c"
+
+void setUp(void) {
+    mem_reset_brk();
+    TEST_ASSERT(mm_span_init(mem_heap_lo()) == 0);
+}
+
+void tearDown(void) {
+
+}
+
+static int list_len(long pages) {
+    Span *head = &span_lists[pages < SPAN_LISTS ? pages : 0];
+    int len = 0;
+    for (Span *span = head->next; span != head; span = span->next)
+        len++;
+    return len;
+}
+
+void test_alloc_free(void) {
+    char *p = mm_span_alloc(1);
+    char *q = mm_span_alloc(3 * SPAN_PAGE);
+    TEST_ASSERT((uintptr_t)p % SPAN_PAGE == 0);
+    TEST_ASSERT(p + SPAN_PAGE == span_hi);
+    TEST_ASSERT(q + 3 * SPAN_PAGE == p);  // the page heap grows down
+    TEST_ASSERT(mm_span_size(p) == SPAN_PAGE);
+    TEST_ASSERT(mm_span_size(q) == 3 * SPAN_PAGE);
+    TEST_ASSERT(mm_span_owns(q + 100) && !mm_span_owns(q - 1));
+    TEST_ASSERT(mm_span_allocated_bytes() == 4 * SPAN_PAGE);
+    TEST_ASSERT(mm_span_alloc(0) == NULL);
+
+    // freed spans merge, a shorter span is carved from the front
+    mm_span_free(p);
+    mm_span_free(q);
+    TEST_ASSERT(mm_span_allocated_bytes() == 0);
+    TEST_ASSERT(list_len(4) == 1 && list_len(1) == 0 && list_len(3) == 0);
+    TEST_ASSERT(mm_span_alloc(2 * SPAN_PAGE - 8) == q);
+    TEST_ASSERT(list_len(4) == 0 && list_len(2) == 1);
+
+    // no page added while a free span fits
+    char *lo = span_lo;
+    TEST_ASSERT(mm_span_alloc(SPAN_PAGE) == q + 2 * SPAN_PAGE);
+    TEST_ASSERT(span_lo == lo);
+}
+
+void test_long_spans(void) {
+    // across leaves of the map, best fit among spans of 128 pages or more
+    char *a = mm_span_alloc(600 * SPAN_PAGE);
+    char *guard1 = mm_span_alloc(SPAN_PAGE);
+    char *b = mm_span_alloc(150 * SPAN_PAGE);
+    char *guard2 = mm_span_alloc(SPAN_PAGE);
+    mm_span_free(a);
+    mm_span_free(b);
+    TEST_ASSERT(list_len(0) == 2);
+    TEST_ASSERT(mm_span_alloc(140 * SPAN_PAGE) == b);
+    TEST_ASSERT(list_len(10) == 1);
+    TEST_ASSERT(mm_span_alloc(300 * SPAN_PAGE) == a);
+
+    mm_span_free(guard1);
+    mm_span_free(guard2);
+    TEST_ASSERT(mm_span_allocated_bytes() == (140 + 300) * SPAN_PAGE);
+}
+
+void test_resize(void) {
+    char *a = mm_span_alloc(SPAN_PAGE);
+    char *b = mm_span_alloc(SPAN_PAGE);
+
+    // grows into the free pages after it only
+    TEST_ASSERT(mm_span_resize(b, 2 * SPAN_PAGE) == -1);
+    mm_span_free(a);
+    TEST_ASSERT(mm_span_resize(b, SPAN_PAGE + 1) == 0);
+    TEST_ASSERT(mm_span_size(b) == 2 * SPAN_PAGE);
+    TEST_ASSERT(mm_span_resize(b, 3 * SPAN_PAGE) == -1);  // at the end of the range
+
+    // shrinks by freeing its last pages
+    TEST_ASSERT(mm_span_resize(b, 100) == 0);
+    TEST_ASSERT(mm_span_size(b) == SPAN_PAGE);
+    TEST_ASSERT(mm_span_allocated_bytes() == SPAN_PAGE);
+    TEST_ASSERT(mm_span_alloc(SPAN_PAGE) == a);
+}
+
+void test_release(void) {
+    long size = mem_heapsize();
+    char *a = mm_span_alloc(SPAN_PAGE);
+    char *b = mm_span_alloc(2 * SPAN_PAGE);
+    TEST_ASSERT(mem_heapsize() == size + 3 * SPAN_PAGE);
+    TEST_ASSERT(mm_span_release() == 0);  // the lowest span is allocated
+
+    // the free pages at the bottom go back to memlib
+    mm_span_free(b);
+    TEST_ASSERT(mm_span_release() == 2 * SPAN_PAGE);
+    TEST_ASSERT(span_lo == a && mem_heapsize() == size + SPAN_PAGE);
+    mm_span_free(a);
+    TEST_ASSERT(mm_span_release() == SPAN_PAGE);
+    TEST_ASSERT(mem_heapsize() == size);
+    TEST_ASSERT(mm_span_release() == 0);
+
+    // the lowest free span grows by the missing pages only
+    a = mm_span_alloc(SPAN_PAGE);
+    b = mm_span_alloc(SPAN_PAGE);
+    mm_span_free(b);
+    TEST_ASSERT(mm_span_alloc(3 * SPAN_PAGE) == a - 3 * SPAN_PAGE);
+    TEST_ASSERT(mem_heapsize() == size + 4 * SPAN_PAGE);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_alloc_free);
+    RUN_TEST(test_long_spans);
+    RUN_TEST(test_resize);
+    RUN_TEST(test_release);
+    mem_deinit();
+    return UNITY_END();
+}
@@ -0,0 +1,125 @@
+#include "unity.h"
+
+#include "mm_tiny.c"
+
+static char heap[4 * 4096] __attribute__((aligned(8)));  // containers go here
+
+// containers are blocks of the mm heap: payloads 4 bytes into an 8-byte word
+#define PAGE(n) (heap + 12 + (n) * 4096)
+
+/**
+ * Address `offset` bytes from the start of `heap`, possibly outside it:
+ * computed out of line, so that the compiler does not see an access out of
+ * the bounds of the array once `mm_tiny_...` is inlined.
+ */
+static __attribute__((noinline)) char *heap_at(long offset) {
+    return (char *)((uintptr_t)heap + offset);
+}
+
+void setUp(void) {
+    mm_tiny_init(heap, sizeof(heap));
+}
+
+void tearDown(void) {
+
+}
+
+void test_alloc_free(void) {
+    TEST_ASSERT(mm_tiny_alloc() == NULL);  // no container yet
+
+    TEST_ASSERT(mm_tiny_add_page(PAGE(0)) == 0);
+    char *c1 = mm_tiny_alloc();
+    char *c2 = mm_tiny_alloc();
+    TEST_ASSERT(c1 == PAGE(0) + TINY_HEADER);
+    TEST_ASSERT(c2 == c1 + 8);  // packed, no header
+
+    // last freed, first reused
+    TEST_ASSERT(mm_tiny_free(c1) == NULL);
+    TEST_ASSERT(mm_tiny_alloc() == c1);
+    mm_tiny_free(c1);
+
+    // the only empty container is kept
+    TEST_ASSERT(mm_tiny_free(c2) == NULL);
+    TEST_ASSERT(mm_tiny_page_of(c2) == PAGE(0));
+    TEST_ASSERT(mm_tiny_alloc() == c2);
+}
+
+void test_page_of(void) {
+    mm_tiny_add_page(PAGE(0));
+    mm_tiny_add_page(PAGE(1));
+    int cells = (TINY_PAGE_BYTES - TINY_HEADER) / TINY_SIZE;
+    char *first = PAGE(0) + TINY_HEADER;
+    char *last = first + (cells - 1) * TINY_SIZE;
+
+    // cells of a container span two pages of the map
+    TEST_ASSERT(mm_tiny_page_of(first) == PAGE(0));
+    TEST_ASSERT(mm_tiny_page_of(last) == PAGE(0));
+    TEST_ASSERT(mm_tiny_page_of(PAGE(1) + TINY_HEADER) == PAGE(1));
+
+    // not cells: headers, the space between containers, outside the range
+    TEST_ASSERT(mm_tiny_page_of(PAGE(0)) == NULL);
+    TEST_ASSERT(mm_tiny_page_of(PAGE(1)) == NULL);
+    TEST_ASSERT(mm_tiny_page_of(PAGE(2) + TINY_HEADER) == NULL);
+    TEST_ASSERT(mm_tiny_page_of(heap_at(-8)) == NULL);
+    TEST_ASSERT(mm_tiny_page_of(heap_at(sizeof(heap) + 4096)) == NULL);
+}
+
+void test_grow_map(void) {
+    // a map of the second page only
+    TEST_ASSERT(mm_tiny_init(heap + 4096, 4096) == 0);
+    TEST_ASSERT(tiny_pages == 1);
+    TEST_ASSERT(mm_tiny_add_page(PAGE(1)) == 0);
+    char *cell = mm_tiny_alloc();
+    TEST_ASSERT(cell == PAGE(1) + TINY_HEADER);
+
+    // a container above the map, then one below it (as in an extra region)
+    TEST_ASSERT(mm_tiny_add_page(PAGE(2)) == 0);
+    TEST_ASSERT(tiny_pages == 2);
+    TEST_ASSERT(mm_tiny_add_page(PAGE(0)) == 0);
+    TEST_ASSERT(tiny_base == heap && tiny_pages == 3);
+
+    // containers already mapped moved with the base
+    TEST_ASSERT(mm_tiny_page_of(cell) == PAGE(1));
+    TEST_ASSERT(mm_tiny_page_of(PAGE(2) + TINY_HEADER) == PAGE(2));
+    TEST_ASSERT(mm_tiny_page_of(PAGE(0) + TINY_HEADER) == PAGE(0));
+    TEST_ASSERT(mm_tiny_page_of(PAGE(0)) == NULL);
+}
+
+void test_full_and_empty(void) {
+    mm_tiny_add_page(PAGE(0));
+    mm_tiny_add_page(PAGE(1));
+    int cells = (TINY_PAGE_BYTES - TINY_HEADER) / TINY_SIZE;
+
+    // all cells of both containers, then none left
+    static char *cell[2 * (4096 / 8)];
+    for (int i = 0; i < 2 * cells; i++)
+        cell[i] = mm_tiny_alloc();
+    TEST_ASSERT(mm_tiny_alloc() == NULL);
+    TEST_ASSERT(mm_tiny_page_of(cell[0]) != mm_tiny_page_of(cell[2 * cells - 1]));
+
+    // a full container is reused once a cell is freed
+    mm_tiny_free(cell[3]);
+    TEST_ASSERT(mm_tiny_alloc() == cell[3]);
+
+    // the first container to empty is kept, the second is given back
+    char *page_a = mm_tiny_page_of(cell[0]);
+    char *page_b = mm_tiny_page_of(cell[cells]);
+    for (int i = 0; i < cells; i++)
+        TEST_ASSERT(mm_tiny_free(cell[i]) == NULL);
+    for (int i = cells; i < 2 * cells - 1; i++)
+        TEST_ASSERT(mm_tiny_free(cell[i]) == NULL);
+    TEST_ASSERT(mm_tiny_free(cell[2 * cells - 1]) == page_b);
+    TEST_ASSERT(mm_tiny_page_of(cell[cells]) == NULL);
+
+    // the kept one still serves cells
+    TEST_ASSERT(mm_tiny_page_of(mm_tiny_alloc()) == page_a);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_alloc_free);
+    RUN_TEST(test_page_of);
+    RUN_TEST(test_grow_map);
+    RUN_TEST(test_full_and_empty);
+    return UNITY_END();
+}
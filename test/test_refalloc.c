@@ -0,0 +1,74 @@
+#include "unity.h"
+#include "memlib.h"
+
+#include "refalloc.c"
+
+void setUp(void) {
+    mem_reset_brk();
+}
+
+void tearDown(void) {
+
+}
+
+void test_bump(void) {
+    TEST_ASSERT(ref_bump_init() == 0);
+    char *a = ref_bump_malloc(10);
+    char *b = ref_bump_malloc(1);
+    TEST_ASSERT((uintptr_t)a % 8 == 0);
+    TEST_ASSERT(b == a + 16);  // 4-byte header, no reuse
+    TEST_ASSERT(ref_bump_malloc(0) == NULL);
+
+    // the last block grows in place
+    TEST_ASSERT(ref_bump_realloc(b, 100) == b);
+
+    // another block moves to a block of exactly the new size
+    memset(a, 0x0a, 10);
+    char *c = ref_bump_realloc(a, 20);
+    TEST_ASSERT(c == b + 104);
+    for (int i = 0; i < 10; i++)
+        TEST_ASSERT(c[i] == 0x0a);
+    char *d = ref_bump_malloc(8);
+    TEST_ASSERT(d == c + 24);
+
+    // freed blocks are never reused, even once all blocks are free
+    ref_bump_free(b);
+    ref_bump_free(c);
+    ref_bump_free(d);
+    TEST_ASSERT(ref_bump_malloc(8) == d + 16);
+}
+
+void test_implicit(void) {
+    TEST_ASSERT(ref_implicit_init() == 0);
+    char *a = ref_implicit_malloc(8);
+    char *b = ref_implicit_malloc(8);
+    char *c = ref_implicit_malloc(8);
+    TEST_ASSERT(b == a + 16 && c == b + 16);
+
+    // first fit, after coalescing with both neighbors
+    ref_implicit_free(a);
+    ref_implicit_free(c);
+    ref_implicit_free(b);
+    TEST_ASSERT(ref_implicit_malloc(40) == a);
+
+    // realloc absorbs the free block after it, else moves
+    char *p = ref_implicit_malloc(8);
+    TEST_ASSERT(p == a + 48);
+    memset(p, 0x0b, 8);
+    TEST_ASSERT(ref_implicit_realloc(p, 100) == p);
+    char *guard = ref_implicit_malloc(8);
+    char *q = ref_implicit_realloc(p, 1000);
+    TEST_ASSERT(q != p && q > guard);
+    for (int i = 0; i < 8; i++)
+        TEST_ASSERT(q[i] == 0x0b);
+    TEST_ASSERT(ref_implicit_malloc(100) == p);  // the old block is free again
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    mem_init();
+    RUN_TEST(test_bump);
+    RUN_TEST(test_implicit);
+    mem_deinit();
+    return UNITY_END();
+}